@@ -12,21 +12,41 @@ AssetStore::~AssetStore() {
 }
 
 void AssetStore::ClearAssets() {
-	for (auto& texture : textures) {
-		SDL_DestroyTexture(texture.second);
+	for (auto texture : textures) {
+		SDL_DestroyTexture(texture);
 	}
 	textures.clear();
+	textureHandles.clear();
 }
 
-void AssetStore::AddTexture(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath) {
+AssetHandle AssetStore::AddTexture(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath) {
 	SDL_Surface* surface = IMG_Load(filePath.c_str());
 	SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
 	SDL_FreeSurface(surface);
-	textures.emplace(assetId, texture);
+
+	// Adding the same asset id again replaces the texture and keeps the handle
+	auto existing = textureHandles.find(assetId);
+	if (existing != textureHandles.end()) {
+		SDL_DestroyTexture(textures[existing->second]);
+		textures[existing->second] = texture;
+		Logger::Log("Texture replaced in the Asset Store with id " + assetId);
+		return existing->second;
+	}
+
+	const AssetHandle assetHandle = static_cast<AssetHandle>(textures.size());
+	textures.push_back(texture);
+	textureHandles.emplace(assetId, assetHandle);
 
 	Logger::Log("Texture added to the Asset Store with id " + assetId);
+
+	return assetHandle;
 }
 
-SDL_Texture* AssetStore::GetTexture(const std::string& assetId) const {
-	return textures.at(assetId);
-}
\ No newline at end of file
+AssetHandle AssetStore::GetTextureHandle(const std::string& assetId) const {
+	auto assetHandle = textureHandles.find(assetId);
+	if (assetHandle == textureHandles.end()) {
+		Logger::Err("Texture with id " + assetId + " is not in the Asset Store.");
+		return INVALID_ASSET_HANDLE;
+	}
+	return assetHandle->second;
+}
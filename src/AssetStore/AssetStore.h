@@ -3,20 +3,38 @@
 
 #include "SDL.h"
 #include <string>
-#include <map>
+#include <vector>
+#include <unordered_map>
+
+// Index of an asset in the asset store, handed out when the asset is added
+typedef int AssetHandle;
+
+const AssetHandle INVALID_ASSET_HANDLE = -1;
 
 class AssetStore
 {
 private:
-	std::map<std::string, SDL_Texture*> textures;
+	// Textures indexed by their asset handle
+	std::vector<SDL_Texture*> textures;
+
+	// Asset id to asset handle, only used when assets are added or looked up by name
+	std::unordered_map<std::string, AssetHandle> textureHandles;
 	// TODO: Add fonts and sounds
 public:
 	AssetStore();
 	~AssetStore();
 
 	void ClearAssets();
-	void AddTexture(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath);
-	SDL_Texture* GetTexture(const std::string& assetId) const;
+	AssetHandle AddTexture(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath);
+	AssetHandle GetTextureHandle(const std::string& assetId) const;
+
+	// Returns nullptr for INVALID_ASSET_HANDLE or any other handle the store didnt hand out
+	SDL_Texture* GetTexture(AssetHandle assetHandle) const {
+		if (assetHandle < 0 || assetHandle >= static_cast<AssetHandle>(textures.size())) {
+			return nullptr;
+		}
+		return textures[assetHandle];
+	}
 };
 
-#endif // ASSETSTORE_H
\ No newline at end of file
+#endif // ASSETSTORE_H
@@ -0,0 +1,27 @@
+#ifndef PARENTCOMPONENT_H
+#define PARENTCOMPONENT_H
+
+#include "../ECS/ECS.h"
+#include <glm/glm.hpp>
+
+// Attaches an entity to a parent, the HierarchySystem writes the world transform of the entity
+// from the transform of the parent and the local offset below
+// Call MarkChanged<ParentComponent>() after changing it at runtime
+// A null parent detaches the entity, it becomes a root and keeps its transform
+// Killing the parent kills its children too, in the next update of the HierarchySystem
+struct ParentComponent
+{
+	EntityHandle parent;
+	glm::vec2 localPosition;
+	glm::vec2 localScale;
+	double localRotation;
+
+	ParentComponent(EntityHandle parent = EntityHandle(), glm::vec2 localPosition = glm::vec2(0, 0), glm::vec2 localScale = glm::vec2(1, 1), double localRotation = 0.0) {
+		this->parent = parent;
+		this->localPosition = localPosition;
+		this->localScale = localScale;
+		this->localRotation = localRotation;
+	}
+};
+
+#endif
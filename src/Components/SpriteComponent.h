@@ -2,27 +2,26 @@
 #define SPRITECOMPONENT_H
 
 #include "SDL.h"
-#include <string>
+#include "../AssetStore/AssetStore.h"
+#include "../ECS/ECS.h"
 
+// Fields the animation and render loops read every frame
 struct SpriteComponent {
-	std::string assetId;
+	AssetHandle assetHandle;
 	int width;
 	int height;
-	int zIndex;
 	SDL_Rect srcRect;
 
 	SpriteComponent(
-		std::string assetId = "",
+		AssetHandle assetHandle = INVALID_ASSET_HANDLE,
 		int width = 0,
 		int height = 0,
-		int zIndex = 0,
 		int srcRectX = 0, 
 		int srcRectY = 0
 	) {
-		this->assetId = assetId;
+		this->assetHandle = assetHandle;
 		this->width = width;
 		this->height = height;
-		this->zIndex = zIndex;
 		this->srcRect = {
 			srcRectX,
 			srcRectY,
@@ -32,4 +31,19 @@ struct SpriteComponent {
 	}
 };
 
+// Fields of a sprite that are only read when the draw order changes
+// Call MarkChanged<SpriteColdComponent>() after changing zIndex at runtime
+struct SpriteColdComponent {
+	int zIndex;
+
+	SpriteColdComponent(int zIndex = 0) {
+		this->zIndex = zIndex;
+	}
+};
+
+template <>
+struct ColdComponent<SpriteComponent> {
+	typedef SpriteColdComponent Type;
+};
+
 #endif
@@ -0,0 +1,39 @@
+#ifndef TILECOMPONENT_H
+#define TILECOMPONENT_H
+
+#include "SDL.h"
+#include "../AssetStore/AssetStore.h"
+
+// Texture and size of the tiles of a tilemap
+// Added as a shared component, so the whole map stores it once and is drawn texture by texture
+struct TilemapComponent {
+	AssetHandle assetHandle;
+	int width;
+	int height;
+
+	TilemapComponent(AssetHandle assetHandle = INVALID_ASSET_HANDLE, int width = 0, int height = 0) {
+		this->assetHandle = assetHandle;
+		this->width = width;
+		this->height = height;
+	}
+
+	bool operator ==(const TilemapComponent& other) const {
+		return assetHandle == other.assetHandle && width == other.width && height == other.height;
+	}
+};
+
+// Part of the tilemap texture a single tile shows
+struct TileComponent {
+	SDL_Rect srcRect;
+
+	TileComponent(int srcRectX = 0, int srcRectY = 0, int width = 0, int height = 0) {
+		this->srcRect = {
+			srcRectX,
+			srcRectY,
+			width,
+			height
+		};
+	}
+};
+
+#endif
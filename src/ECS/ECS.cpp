@@ -1,52 +1,428 @@
 #include "ECS.h"
 #include "../Logger/Logger.h"
+#include <algorithm>
+#include <cstring>
+#include <cmath>
 
-int IComponent::nextId = 0;
+std::atomic<int> IComponent::nextId{ 0 };
+
+std::recursive_mutex& IComponent::IdMutex() {
+	static std::recursive_mutex idMutex;
+	return idMutex;
+}
+
+std::vector<ComponentTypeInfo>& IComponent::TypeInfos() {
+	static std::vector<ComponentTypeInfo> typeInfos(MAX_COMPONENTS);
+	return typeInfos;
+}
+
+const ComponentTypeInfo& GetComponentTypeInfo(int componentId) {
+	return IComponent::TypeInfos()[componentId];
+}
+
+void ComponentTypeInfo::CopyConstruct(void* destination, const void* source, int count) const {
+	if (isTriviallyCopyable) {
+		std::memcpy(destination, source, size * count);
+		return;
+	}
+	if (!copyConstruct) {
+		Logger::Err("Component type " + name + " cannot be copied.");
+		return;
+	}
+	for (int i = 0; i < count; i++) {
+		copyConstruct(static_cast<unsigned char*>(destination) + i * size, static_cast<const unsigned char*>(source) + i * size);
+	}
+}
+
+void ComponentTypeInfo::Relocate(void* destination, void* source, int count) const {
+	if (isTriviallyRelocatable) {
+		std::memcpy(destination, source, size * count);
+		return;
+	}
+	for (int i = 0; i < count; i++) {
+		void* component = static_cast<unsigned char*>(source) + i * size;
+		moveConstruct(static_cast<unsigned char*>(destination) + i * size, component);
+		destroy(component);
+	}
+}
+
+void ComponentTypeInfo::Destroy(void* object, int count) const {
+	if (isTriviallyDestructible) {
+		return;
+	}
+	for (int i = 0; i < count; i++) {
+		destroy(static_cast<unsigned char*>(object) + i * size);
+	}
+}
 
 int Entity::GetId() const {
-	return id;
+	return handle.GetIndex();
+}
+
+EntityHandle Entity::GetHandle() const {
+	return handle;
 }
 
 void Entity::Kill() {
 	registry->KillEntity(*this);
 }
 
+bool Entity::IsAlive() const {
+	return registry->IsAlive(handle);
+}
+
+void Entity::Enable() {
+	registry->SetEntityEnabled(*this, true);
+}
+
+void Entity::Disable() {
+	registry->SetEntityEnabled(*this, false);
+}
+
+bool Entity::IsEnabled() const {
+	return registry->IsEntityEnabled(GetId());
+}
+
+void Entity::Tag(const std::string& tag) {
+	registry->TagEntity(*this, tag);
+}
+
+bool Entity::HasTag(const std::string& tag) const {
+	return registry->EntityHasTag(*this, tag);
+}
+
+void Entity::Group(const std::string& group) {
+	registry->GroupEntity(*this, group);
+}
+
+bool Entity::BelongsToGroup(const std::string& group) const {
+	return registry->EntityBelongsToGroup(*this, group);
+}
+
 void System::AddEntityToSystem(Entity entity) {
-	for (auto& e : entities) {
-		if (e == entity) {
-			Logger::Log("Entity already exists in system.");
-			return;
-		}
+	if (HasEntity(entity)) {
+		Logger::Log("Entity already exists in system.");
+		return;
 	}
-	Logger::Log("Adding entity with id: " + std::to_string(entity.GetId()) + " to system.");
-	entities.push_back(entity);
+
+	const int entityId = entity.GetId();
+	if (entityId >= static_cast<int>(entityIdToIndex.size())) {
+		entityIdToIndex.resize(entityId + 1, -1);
+	}
+
+	entityIdToIndex[entityId] = static_cast<int>(entities.size());
+	entities.push_back(entity.GetHandle());
+	if (registry->IsEntityEnabled(entityId)) {
+		SwapEntities(static_cast<int>(entities.size()) - 1, numEnabledEntities++);
+	}
+	membershipVersion++;
 }
 
 void System::RemoveEntityFromSystem(Entity entity) {
-	Logger::Log("Removing entity with id: " + std::to_string(entity.GetId()) + " from system.");
-	entities.erase(std::remove_if(
-		entities.begin(), 
-		entities.end(),
-		[&entity](Entity& e) {
-			return e == entity;
-		}
-	), entities.end());
+	if (!HasEntity(entity)) {
+		return;
+	}
+
+	const int entityId = entity.GetId();
+
+	// Move the entity out of the enabled entities first, then move the last entity into the hole
+	int index = entityIdToIndex[entityId];
+	if (index < numEnabledEntities) {
+		SwapEntities(index, --numEnabledEntities);
+		index = numEnabledEntities;
+	}
+	const EntityHandle lastEntity = entities.back();
+	entities[index] = lastEntity;
+	entityIdToIndex[lastEntity.GetIndex()] = index;
+
+	entities.pop_back();
+	entityIdToIndex[entityId] = -1;
+	membershipVersion++;
 }
 
-std::vector<Entity> System::GetSystemEntities() const {
-	return entities;
+bool System::HasEntity(Entity entity) const {
+	const int entityId = entity.GetId();
+	return entityId < static_cast<int>(entityIdToIndex.size()) && entityIdToIndex[entityId] != -1;
 }
+
+EntitySpan System::GetSystemEntities() const {
+	return EntitySpan(entities.data(), entities.data() + numEnabledEntities, registry);
+}
+
+EntitySpan System::GetAllSystemEntities() const {
+	return EntitySpan(entities.data(), entities.data() + entities.size(), registry);
+}
+
 const Signature& System::GetComponentSignature() const {
 	return componentSignature;
 }
 
+uint32_t System::GetMembershipVersion() const {
+	return membershipVersion;
+}
+
+void System::RemapEntity(EntityHandle entity, EntityHandle newEntity) {
+	const int entityId = entity.GetIndex();
+	if (entityId >= static_cast<int>(entityIdToIndex.size()) || entityIdToIndex[entityId] == -1) {
+		return;
+	}
+
+	const int newEntityId = newEntity.GetIndex();
+	if (newEntityId >= static_cast<int>(entityIdToIndex.size())) {
+		entityIdToIndex.resize(newEntityId + 1, -1);
+	}
+
+	const int index = entityIdToIndex[entityId];
+	entities[index] = newEntity;
+	entityIdToIndex[entityId] = -1;
+	entityIdToIndex[newEntityId] = index;
+	membershipVersion++;
+}
+
+void System::SwapEntities(int index, int otherIndex) {
+	std::swap(entities[index], entities[otherIndex]);
+	entityIdToIndex[entities[index].GetIndex()] = index;
+	entityIdToIndex[entities[otherIndex].GetIndex()] = otherIndex;
+}
+
+void System::SetEntityEnabled(Entity entity, bool isEnabled) {
+	if (!HasEntity(entity)) {
+		return;
+	}
+
+	const int index = entityIdToIndex[entity.GetId()];
+	if (isEnabled && index >= numEnabledEntities) {
+		SwapEntities(index, numEnabledEntities++);
+	}
+	else if (!isEnabled && index < numEnabledEntities) {
+		SwapEntities(index, --numEnabledEntities);
+	}
+	else {
+		return;
+	}
+	membershipVersion++;
+}
+
+void System::ShrinkEntityIds(int numEntityIds) {
+	if (static_cast<int>(entityIdToIndex.size()) > numEntityIds) {
+		entityIdToIndex.resize(numEntityIds);
+		entityIdToIndex.shrink_to_fit();
+	}
+}
+
+void System::SetTimeSlicing(int numSlices, double budgetMilliseconds) {
+	numTimeSlices = std::max(numSlices, 1);
+	timeBudgetMilliseconds = budgetMilliseconds;
+}
+
+bool System::ConflictsWith(const System& other) const {
+	if ((readSignature.none() && writeSignature.none()) || (other.readSignature.none() && other.writeSignature.none())) {
+		return true;
+	}
+	return writeSignature.Intersects(other.readSignature | other.writeSignature) || other.writeSignature.Intersects(readSignature);
+}
+
+Archetype::Archetype(const Signature& signature) : signature(signature) {
+	componentIdToColumn.resize(MAX_COMPONENTS, -1);
+
+	size_t rowBytes = 0;
+	signature.ForEachSetBit([&](int componentId) {
+		componentIdToColumn[componentId] = static_cast<int>(componentIds.size());
+		componentIds.push_back(componentId);
+		columnInfos.push_back(&GetComponentTypeInfo(componentId));
+		rowBytes += columnInfos.back()->size;
+	});
+	columnOffsets.resize(componentIds.size());
+
+	// Fit as many rows as possible in a chunk, each column aligned for its component type
+	chunkCapacity = std::max(1, static_cast<int>(ARCHETYPE_CHUNK_SIZE / std::max<size_t>(rowBytes, 1)));
+	while (true) {
+		size_t offset = 0;
+		for (size_t column = 0; column < columnInfos.size(); column++) {
+			const size_t alignment = columnInfos[column]->alignment;
+			offset = (offset + alignment - 1) / alignment * alignment;
+			columnOffsets[column] = offset;
+			offset += columnInfos[column]->size * chunkCapacity;
+		}
+		if (offset <= ARCHETYPE_CHUNK_SIZE || chunkCapacity == 1) {
+			chunkBytes = std::max<size_t>(offset, ARCHETYPE_CHUNK_SIZE);
+			break;
+		}
+		chunkCapacity--;
+	}
+}
+
+Archetype::~Archetype() {
+	for (auto& chunk : chunks) {
+		// Whole columns at once, nothing to do for trivially destructible types
+		for (size_t column = 0; column < columnInfos.size(); column++) {
+			columnInfos[column]->Destroy(chunk.memory + columnOffsets[column], chunk.count);
+		}
+		::operator delete(chunk.memory, std::align_val_t(64));
+	}
+}
+
+void Archetype::AllocateRow(int entityId, int& chunkIndex, int& row) {
+	if (chunks.empty() || chunks.back().count == chunkCapacity) {
+		ArchetypeChunk chunk;
+		chunk.memory = static_cast<unsigned char*>(::operator new(chunkBytes, std::align_val_t(64)));
+		chunk.entityIds.reserve(chunkCapacity);
+		chunks.push_back(std::move(chunk));
+	}
+
+	ArchetypeChunk& chunk = chunks.back();
+	chunkIndex = static_cast<int>(chunks.size()) - 1;
+	row = chunk.count++;
+	chunk.entityIds.push_back(entityId);
+}
+
+int Archetype::RemoveRow(int chunkIndex, int row, bool destroyComponents) {
+	ArchetypeChunk& chunk = chunks[chunkIndex];
+	ArchetypeChunk& lastChunk = chunks.back();
+	const int lastRow = lastChunk.count - 1;
+
+	if (destroyComponents) {
+		for (size_t column = 0; column < columnInfos.size(); column++) {
+			columnInfos[column]->Destroy(GetComponent(componentIds[column], chunkIndex, row));
+		}
+	}
+
+	// Keep every chunk but the last one full by moving the last row into the hole
+	int movedEntityId = -1;
+	if (&chunk != &lastChunk || row != lastRow) {
+		const int lastChunkIndex = static_cast<int>(chunks.size()) - 1;
+		for (size_t column = 0; column < columnInfos.size(); column++) {
+			columnInfos[column]->Relocate(GetComponent(componentIds[column], chunkIndex, row), GetComponent(componentIds[column], lastChunkIndex, lastRow));
+		}
+		movedEntityId = lastChunk.entityIds[lastRow];
+		chunk.entityIds[row] = movedEntityId;
+	}
+
+	lastChunk.count--;
+	lastChunk.entityIds.pop_back();
+	if (lastChunk.count == 0) {
+		::operator delete(lastChunk.memory, std::align_val_t(64));
+		chunks.pop_back();
+	}
+
+	return movedEntityId;
+}
+
+void ArchetypeStorage::RemapEntity(int entityId, int newEntityId) {
+	if (entityId >= static_cast<int>(entityLocations.size()) || !entityLocations[entityId].archetype) {
+		return;
+	}
+	if (newEntityId >= static_cast<int>(entityLocations.size())) {
+		entityLocations.resize(newEntityId + 1);
+	}
+
+	const EntityLocation location = entityLocations[entityId];
+	location.archetype->GetChunk(location.chunkIndex).entityIds[location.row] = newEntityId;
+	entityLocations[newEntityId] = location;
+	entityLocations[entityId] = EntityLocation();
+}
+
+void ArchetypeStorage::ReleaseEmptyArchetypes() {
+	for (auto archetype = archetypes.begin(); archetype != archetypes.end();) {
+		if (archetype->second->GetNumChunks() == 0) {
+			archetype = archetypes.erase(archetype);
+		}
+		else {
+			archetype++;
+		}
+	}
+}
+
+Archetype* ArchetypeStorage::GetOrCreateArchetype(const Signature& signature) {
+	auto archetype = archetypes.find(signature);
+	if (archetype != archetypes.end()) {
+		return archetype->second.get();
+	}
+
+	Logger::Log("Created archetype with signature: " + signature.to_string());
+	auto newArchetype = std::make_unique<Archetype>(signature);
+	Archetype* result = newArchetype.get();
+	archetypes.emplace(signature, std::move(newArchetype));
+	return result;
+}
+
+void ArchetypeStorage::MoveEntity(int entityId, Archetype* target) {
+	if (entityId >= static_cast<int>(entityLocations.size())) {
+		entityLocations.resize(entityId + 1);
+	}
+
+	EntityLocation& location = entityLocations[entityId];
+	Archetype* source = location.archetype;
+
+	int chunkIndex = -1;
+	int row = -1;
+	if (target) {
+		target->AllocateRow(entityId, chunkIndex, row);
+	}
+
+	if (source) {
+		for (int componentId : source->GetComponentIds()) {
+			void* component = source->GetComponent(componentId, location.chunkIndex, location.row);
+			if (target && target->HasComponent(componentId)) {
+				GetComponentTypeInfo(componentId).Relocate(target->GetComponent(componentId, chunkIndex, row), component);
+			}
+			else {
+				GetComponentTypeInfo(componentId).Destroy(component);
+			}
+		}
+
+		const int movedEntityId = source->RemoveRow(location.chunkIndex, location.row, false);
+		if (movedEntityId != -1) {
+			entityLocations[movedEntityId].chunkIndex = location.chunkIndex;
+			entityLocations[movedEntityId].row = location.row;
+		}
+	}
+
+	location.archetype = target;
+	location.chunkIndex = chunkIndex;
+	location.row = row;
+}
+
+void* ArchetypeStorage::AddComponent(int entityId, int componentId, const Signature& newSignature) {
+	Archetype* target = GetOrCreateArchetype(newSignature);
+	MoveEntity(entityId, target);
+
+	const EntityLocation& location = entityLocations[entityId];
+	return target->GetComponent(componentId, location.chunkIndex, location.row);
+}
+
+void ArchetypeStorage::AddEntity(int entityId, const Signature& signature) {
+	MoveEntity(entityId, GetOrCreateArchetype(signature));
+}
+
+void ArchetypeStorage::RemoveComponent(int entityId, int, const Signature& newSignature) {
+	// Entities without components dont belong to any archetype
+	MoveEntity(entityId, newSignature.none() ? nullptr : GetOrCreateArchetype(newSignature));
+}
+
+void ArchetypeStorage::RemoveEntity(int entityId) {
+	if (entityId < static_cast<int>(entityLocations.size()) && entityLocations[entityId].archetype) {
+		MoveEntity(entityId, nullptr);
+	}
+}
+
 Entity Registry::CreateEntity() {
 	int entityId;
 
 	if (freeIds.empty()) {
+		// A larger id would not fit in a handle and alias the entity with the lowest ids
+		if (numEntities >= MAX_ENTITIES) {
+			Logger::Err("Cannot create more than " + std::to_string(MAX_ENTITIES) + " entities.");
+			return GetEntity(EntityHandle());
+		}
 		entityId = numEntities++;
 		if (entityId >= entityComponentSignatures.size()) {
 			entityComponentSignatures.resize(entityId + 1);
+			entitySystemSignatures.resize(entityId + 1);
+		}
+		// Compact shrinks the signatures but not the generations
+		if (entityId >= static_cast<int>(entityGenerations.size())) {
+			entityGenerations.resize(entityId + 1, 0);
 		}
 	}
 	else {
@@ -54,56 +430,953 @@ Entity Registry::CreateEntity() {
 		freeIds.pop_front();
 	}
 
-	Entity entity(entityId);
-	entity.registry = this;
-	entitiesToBeAdded.insert(entity);
+	Entity entity = GetEntity(EntityHandle(entityId, entityGenerations[entityId]));
+	entityCommands.push_back({ EntityCommandType::Create, entity.GetHandle() });
 
 	Logger::Log("Created entity with id: " + std::to_string(entityId));
 
 	return entity;
 }
 
+std::vector<Entity> Registry::CreateEntities(int count) {
+	// Only as many entities as there are ids left, see CreateEntity
+	const int numAvailable = static_cast<int>(freeIds.size()) + MAX_ENTITIES - numEntities;
+	if (count > numAvailable) {
+		Logger::Err("Cannot create more than " + std::to_string(MAX_ENTITIES) + " entities, creating " + std::to_string(numAvailable) + " of " + std::to_string(count) + ".");
+		count = numAvailable;
+	}
+
+	std::vector<Entity> entities;
+	entities.reserve(count);
+	entityCommands.reserve(entityCommands.size() + count);
+
+	// Reuse free ids first, then grow the per entity vectors once for the rest
+	const int numReused = std::min(count, static_cast<int>(freeIds.size()));
+	const int numNew = count - numReused;
+	if (numEntities + numNew > static_cast<int>(entityComponentSignatures.size())) {
+		entityComponentSignatures.resize(numEntities + numNew);
+		entitySystemSignatures.resize(numEntities + numNew);
+	}
+	if (numEntities + numNew > static_cast<int>(entityGenerations.size())) {
+		entityGenerations.resize(numEntities + numNew, 0);
+	}
+
+	for (int i = 0; i < count; i++) {
+		int entityId;
+		if (i < numReused) {
+			entityId = freeIds.front();
+			freeIds.pop_front();
+		}
+		else {
+			entityId = numEntities++;
+		}
+
+		Entity entity = GetEntity(EntityHandle(entityId, entityGenerations[entityId]));
+		entityCommands.push_back({ EntityCommandType::Create, entity.GetHandle() });
+		entities.push_back(entity);
+	}
+
+	Logger::Log("Created " + std::to_string(count) + " entities");
+
+	return entities;
+}
+
+std::vector<Entity> Registry::Instantiate(const Prefab& prefab, int count) {
+	std::vector<Entity> entities = CreateEntities(count);
+
+	const Signature& signature = prefab.GetSignature();
+	if (signature.none()) {
+		return entities;
+	}
+
+	for (const auto& component : prefab.GetComponents()) {
+		if (component) {
+			component->RegisterStorage(*this);
+		}
+	}
+
+	// The Create commands are enough for the systems, no per component commands are recorded
+	for (const auto& entity : entities) {
+		entityComponentSignatures.Mutable(entity.GetId()) = signature;
+		if (archetypeStorage) {
+			archetypeStorage->AddEntity(entity.GetId(), signature);
+		}
+	}
+
+	for (const auto& component : prefab.GetComponents()) {
+		if (component) {
+			component->CopyTo(*this, entities);
+		}
+	}
+
+	Logger::Log("Instantiated prefab on " + std::to_string(entities.size()) + " entities");
+
+	return entities;
+}
+
+Entity Registry::GetEntity(EntityHandle handle) {
+	Entity entity(handle);
+	entity.registry = this;
+	return entity;
+}
+
+void Registry::SetEntityEnabled(Entity entity, bool isEnabled) {
+	if (!IsAlive(entity.GetHandle())) {
+		Logger::Err("Trying to enable or disable a stale entity with id: " + std::to_string(entity.GetId()));
+		return;
+	}
+
+	const int entityId = entity.GetId();
+	if (IsEntityEnabled(entityId) == isEnabled) {
+		return;
+	}
+
+	const size_t word = entityId / 64;
+	if (word >= disabledEntityBits.size()) {
+		disabledEntityBits.resize(word + 1, 0);
+	}
+	disabledEntityBits[word] ^= uint64_t(1) << (entityId % 64);
+	numDisabledEntities += isEnabled ? -1 : 1;
+
+	// Views keep disabled entities and skip them while iterating, so they stay valid
+
+	for (System* system : systemList) {
+		system->SetEntityEnabled(entity, isEnabled);
+	}
+}
+
+Entity Registry::CloneEntity(Entity entity) {
+	const int entityId = entity.GetId();
+	const Entity clone = CreateEntity();
+	if (clone.GetHandle().IsNull()) {
+		return clone;
+	}
+	const int cloneId = clone.GetId();
+
+	// Like Instantiate, the Create command is enough for the systems
+	const Signature signature = entityComponentSignatures[entityId];
+	entityComponentSignatures.Mutable(cloneId) = signature;
+	if (signature.none()) {
+		return clone;
+	}
+
+	// Shared components only need the clone to reference the same value
+	(signature & sharedComponentTypes).ForEachSetBit([&](int componentId) {
+		ISharedPool& sharedPool = *sharedComponentPools[componentId];
+		sharedPool.SetValueIndex(clone.GetHandle(), sharedPool.GetValueIndex(entityId));
+	});
+
+	const Signature storedSignature = WithoutSharedComponents(signature);
+	if (archetypeStorage) {
+		if (storedSignature.any()) {
+			archetypeStorage->AddEntity(cloneId, storedSignature);
+		}
+		storedSignature.ForEachSetBit([&](int componentId) {
+			GetComponentTypeInfo(componentId).CopyConstruct(archetypeStorage->GetComponent(cloneId, componentId), archetypeStorage->GetComponent(entityId, componentId));
+		});
+	}
+	else {
+		storedSignature.ForEachSetBit([&](int componentId) {
+			componentPools[componentId]->CopyComponent(entityId, cloneId);
+		});
+	}
+
+	signature.ForEachSetBit([&](int componentId) {
+		StampComponentTicks(componentId, cloneId, true);
+	});
+	IncrementComponentVersions(signature);
+
+	Logger::Log("Cloned entity " + std::to_string(entityId) + " into entity " + std::to_string(cloneId));
+
+	return clone;
+}
+
+std::unique_ptr<Registry> Registry::Fork() {
+	if (archetypeStorage) {
+		Logger::Err("Only registries with the sparse set backend can be forked.");
+		return nullptr;
+	}
+
+	// Pending commands and replacements refer to the systems and observers, which the fork doesnt have
+	const bool hasPendingCommands = std::any_of(commandBuffers.begin(), commandBuffers.end(), [](const std::unique_ptr<CommandBuffer>& commandBuffer) {
+		return !commandBuffer->IsEmpty();
+	});
+	if (!entityCommands.empty() || hasPendingCommands || hasPendingReplacements) {
+		Logger::Err("Registry can only be forked right after Update.");
+		return nullptr;
+	}
+
+	std::unique_ptr<Registry> fork = std::make_unique<Registry>(storageBackend);
+	fork->componentPools.resize(componentPools.size());
+	for (size_t componentId = 0; componentId < componentPools.size(); componentId++) {
+		if (componentPools[componentId]) {
+			fork->componentPools[componentId] = componentPools[componentId]->Fork();
+			if (!fork->componentPools[componentId]) {
+				return nullptr;
+			}
+		}
+	}
+	for (size_t componentId = 0; componentId < sharedComponentPools.size(); componentId++) {
+		if (sharedComponentPools[componentId]) {
+			fork->sharedComponentPools[componentId] = sharedComponentPools[componentId]->Clone();
+		}
+	}
+	fork->sharedComponentTypes = sharedComponentTypes;
+
+	fork->numEntities = numEntities;
+	fork->entityComponentSignatures = entityComponentSignatures;
+	fork->entitySystemSignatures = entitySystemSignatures;
+	fork->entityGenerations = entityGenerations;
+	fork->freeIds = freeIds;
+	fork->disabledEntityBits = disabledEntityBits;
+	fork->numDisabledEntities = numDisabledEntities;
+
+	fork->entityPerTag = entityPerTag;
+	fork->tagPerEntity = tagPerEntity;
+	fork->groupIds = groupIds;
+	fork->groupEntities = groupEntities;
+	fork->entityGroupIds = entityGroupIds;
+	fork->entityGroupIndices = entityGroupIndices;
+
+	fork->needsCompaction = needsCompaction;
+	fork->remappedHandles = remappedHandles;
+
+	fork->componentVersions = componentVersions;
+	// MarkChanged never grows the ticks, it can run from parallel jobs, so the fork needs a copy sized like the original
+	fork->componentTicks = componentTicks;
+	fork->currentTick.store(GetCurrentTick(), std::memory_order_relaxed);
+
+	Logger::Log("Forked registry with " + std::to_string(numEntities - static_cast<int>(freeIds.size())) + " entities");
+
+	return fork;
+}
+
+void Registry::TagEntity(Entity entity, const std::string& tag) {
+	// The id of a stale handle may belong to another entity by now
+	if (!IsAlive(entity.GetHandle())) {
+		Logger::Err("Trying to tag a stale entity with id: " + std::to_string(entity.GetId()));
+		return;
+	}
+	RemoveEntityTag(entity);
+
+	// The tag may still name another entity
+	auto previousEntity = entityPerTag.find(tag);
+	if (previousEntity != entityPerTag.end()) {
+		tagPerEntity.erase(previousEntity->second.GetIndex());
+	}
+
+	entityPerTag[tag] = entity.GetHandle();
+	tagPerEntity[entity.GetId()] = tag;
+}
+
+bool Registry::EntityHasTag(Entity entity, const std::string& tag) const {
+	auto taggedEntity = entityPerTag.find(tag);
+	return taggedEntity != entityPerTag.end() && taggedEntity->second == entity.GetHandle();
+}
+
+Entity Registry::GetEntityByTag(const std::string& tag) {
+	auto taggedEntity = entityPerTag.find(tag);
+	return GetEntity(taggedEntity != entityPerTag.end() ? taggedEntity->second : EntityHandle());
+}
+
+void Registry::RemoveEntityTag(Entity entity) {
+	if (!IsAlive(entity.GetHandle())) {
+		return;
+	}
+	auto tag = tagPerEntity.find(entity.GetId());
+	if (tag != tagPerEntity.end()) {
+		entityPerTag.erase(tag->second);
+		tagPerEntity.erase(tag);
+	}
+}
+
+void Registry::GroupEntity(Entity entity, const std::string& group) {
+	if (!IsAlive(entity.GetHandle())) {
+		Logger::Err("Trying to group a stale entity with id: " + std::to_string(entity.GetId()));
+		return;
+	}
+	RemoveEntityGroup(entity);
+
+	auto groupId = groupIds.find(group);
+	if (groupId == groupIds.end()) {
+		groupId = groupIds.emplace(group, static_cast<int>(groupEntities.size())).first;
+		groupEntities.emplace_back();
+	}
+
+	const int entityId = entity.GetId();
+	if (entityId >= static_cast<int>(entityGroupIds.size())) {
+		entityGroupIds.resize(entityId + 1, -1);
+		entityGroupIndices.resize(entityId + 1, -1);
+	}
+
+	std::vector<EntityHandle>& entities = groupEntities[groupId->second];
+	entityGroupIds[entityId] = groupId->second;
+	entityGroupIndices[entityId] = static_cast<int>(entities.size());
+	entities.push_back(entity.GetHandle());
+}
+
+bool Registry::EntityBelongsToGroup(Entity entity, const std::string& group) const {
+	const int entityId = entity.GetId();
+	if (!IsAlive(entity.GetHandle()) || entityId >= static_cast<int>(entityGroupIds.size()) || entityGroupIds[entityId] == -1) {
+		return false;
+	}
+	auto groupId = groupIds.find(group);
+	return groupId != groupIds.end() && groupId->second == entityGroupIds[entityId];
+}
+
+EntitySpan Registry::GetEntitiesByGroup(const std::string& group) {
+	auto groupId = groupIds.find(group);
+	if (groupId == groupIds.end()) {
+		return EntitySpan(nullptr, nullptr, this);
+	}
+	const std::vector<EntityHandle>& entities = groupEntities[groupId->second];
+	return EntitySpan(entities.data(), entities.data() + entities.size(), this);
+}
+
+void Registry::RemoveEntityGroup(Entity entity) {
+	const int entityId = entity.GetId();
+	if (!IsAlive(entity.GetHandle()) || entityId >= static_cast<int>(entityGroupIds.size()) || entityGroupIds[entityId] == -1) {
+		return;
+	}
+
+	// Move the last entity of the group into the hole
+	std::vector<EntityHandle>& entities = groupEntities[entityGroupIds[entityId]];
+	const int index = entityGroupIndices[entityId];
+	const EntityHandle lastEntity = entities.back();
+	entities[index] = lastEntity;
+	entityGroupIndices[lastEntity.GetIndex()] = index;
+	entities.pop_back();
+
+	entityGroupIds[entityId] = -1;
+	entityGroupIndices[entityId] = -1;
+}
+
+Signature Registry::WithoutSharedComponents(Signature signature) const {
+	sharedComponentTypes.ForEachSetBit([&signature](int componentId) {
+		signature.set(componentId, false);
+	});
+	return signature;
+}
+
+void ISharedPool::SetValueIndex(EntityHandle entity, int valueIndex) {
+	RemoveEntityFromPool(entity.GetIndex());
+
+	const int entityId = entity.GetIndex();
+	if (entityId >= static_cast<int>(entityValueIndices.size())) {
+		entityValueIndices.resize(entityId + 1, -1);
+		entityPositions.resize(entityId + 1, -1);
+	}
+
+	std::vector<EntityHandle>& entities = valueEntities[valueIndex];
+	entityValueIndices[entityId] = valueIndex;
+	entityPositions[entityId] = static_cast<int>(entities.size());
+	entities.push_back(entity);
+}
+
+void ISharedPool::RemoveEntityFromPool(int entityId) {
+	const int valueIndex = GetValueIndex(entityId);
+	if (valueIndex == -1) {
+		return;
+	}
+
+	// Move the last entity of the value into the hole
+	std::vector<EntityHandle>& entities = valueEntities[valueIndex];
+	const int position = entityPositions[entityId];
+	const EntityHandle lastEntity = entities.back();
+	entities[position] = lastEntity;
+	entityPositions[lastEntity.GetIndex()] = position;
+	entities.pop_back();
+
+	entityValueIndices[entityId] = -1;
+	entityPositions[entityId] = -1;
+}
+
+void ISharedPool::RemapEntity(int entityId, EntityHandle newEntity) {
+	const int valueIndex = GetValueIndex(entityId);
+	if (valueIndex == -1) {
+		return;
+	}
+
+	const int newEntityId = newEntity.GetIndex();
+	if (newEntityId >= static_cast<int>(entityValueIndices.size())) {
+		entityValueIndices.resize(newEntityId + 1, -1);
+		entityPositions.resize(newEntityId + 1, -1);
+	}
+
+	valueEntities[valueIndex][entityPositions[entityId]] = newEntity;
+	entityValueIndices[newEntityId] = valueIndex;
+	entityPositions[newEntityId] = entityPositions[entityId];
+	entityValueIndices[entityId] = -1;
+	entityPositions[entityId] = -1;
+}
+
 void Registry::KillEntity(Entity entity) {
+	if (!IsAlive(entity.GetHandle())) {
+		Logger::Err("Trying to kill a stale entity with id: " + std::to_string(entity.GetId()));
+		return;
+	}
 	Logger::Log("Killing entity with id: " + std::to_string(entity.GetId()));
-	entitiesToBeKilled.insert(entity);
+	entityCommands.push_back({ EntityCommandType::Kill, entity.GetHandle() });
 }
 
-void Registry::AddEntityToSystems(Entity entity) {
-	const int entityId = entity.GetId();
+void CommandBuffer::KillEntity(Entity entity) {
+	Record(false, entity.GetId(), [handle = entity.GetHandle()](Registry& registry) {
+		// Several threads may have killed the same entity
+		if (registry.IsAlive(handle)) {
+			registry.KillEntity(registry.GetEntity(handle));
+		}
+	});
+}
 
-	const Signature& entitySignature = entityComponentSignatures[entityId];
-	for (auto& system : systems) {
-		const Signature& systemComponentSignature = system.second->GetComponentSignature();
+void CommandBuffer::SetEntityEnabled(Entity entity, bool isEnabled) {
+	Record(false, entity.GetId(), [handle = entity.GetHandle(), isEnabled](Registry& registry) {
+		if (registry.IsAlive(handle)) {
+			registry.SetEntityEnabled(registry.GetEntity(handle), isEnabled);
+		}
+	});
+}
+
+void CommandBuffer::Instantiate(const Prefab& prefab, int count, int sortKey) {
+	Record(true, sortKey, [&prefab, count](Registry& registry) {
+		registry.Instantiate(prefab, count);
+	});
+}
+
+void Registry::SetJobSystem(JobSystem* jobSystem) {
+	this->jobSystem = jobSystem;
 
-		bool isInterested = (entitySignature & systemComponentSignature) == systemComponentSignature;
-		if (isInterested) {
-			system.second->AddEntityToSystem(entity);
+	// Allocated up front so recording never has to synchronize
+	const size_t numThreads = jobSystem ? jobSystem->GetNumWorkers() + 1 : 1;
+	while (commandBuffers.size() < numThreads) {
+		commandBuffers.push_back(std::make_unique<CommandBuffer>());
+	}
+}
+
+CommandBuffer& Registry::GetCommandBuffer() const {
+	return *commandBuffers[jobSystem ? jobSystem->GetCurrentThreadIndex() : 0];
+}
+
+void Registry::PlaybackCommandBuffers() {
+	std::vector<CommandBuffer::Command*> commands;
+	for (auto& commandBuffer : commandBuffers) {
+		for (auto& command : commandBuffer->commands) {
+			commands.push_back(&command);
+		}
+	}
+	if (commands.empty()) {
+		return;
+	}
+
+	// Origins are unique, so the order doesnt depend on the buffer a command was recorded into
+	// Stable in case two commands ever tie anyway, they then keep the order of the buffers
+	std::stable_sort(commands.begin(), commands.end(), [](const CommandBuffer::Command* a, const CommandBuffer::Command* b) {
+		if (a->isInstantiation != b->isInstantiation) {
+			return b->isInstantiation;
 		}
+		if (a->sortKey != b->sortKey) {
+			return a->sortKey < b->sortKey;
+		}
+		return a->origin < b->origin;
+	});
+	for (CommandBuffer::Command* command : commands) {
+		command->apply(*this);
 	}
+
+	for (auto& commandBuffer : commandBuffers) {
+		commandBuffer->commands.clear();
+		commandBuffer->origin = CommandBuffer::Origin();
+	}
+	numScheduledSystemsRun = 0;
 }
 
-void Registry::RemoveEntityFromSystems(Entity entity) {
+void Registry::UpdateEntitySystems(Entity entity, const Signature& oldSignature, const Signature& newSignature) {
+	if (oldSignature == newSignature) {
+		return;
+	}
+
+	for (size_t i = 0; i < systemSignatures.size(); i++) {
+		const bool wasInterested = oldSignature.Contains(systemSignatures[i]);
+		const bool isInterested = newSignature.Contains(systemSignatures[i]);
+		if (isInterested && !wasInterested) {
+			systemList[i]->AddEntityToSystem(entity);
+		}
+		else if (wasInterested && !isInterested) {
+			systemList[i]->RemoveEntityFromSystem(entity);
+		}
+	}
+}
+
+void Registry::RefreshSystemList() {
+	systemList.clear();
+	systemSignatures.clear();
 	for (auto& system : systems) {
-		system.second->RemoveEntityFromSystem(entity);
+		systemList.push_back(system.second.get());
+		systemSignatures.push_back(system.second->GetComponentSignature());
+	}
+}
+
+void Registry::AddExistingEntities(System& system) {
+	// Systems without required components never get entities, like in UpdateEntitySystems
+	const Signature& systemSignature = system.GetComponentSignature();
+	if (systemSignature.none()) {
+		return;
+	}
+
+	for (int entityId = 0; entityId < static_cast<int>(entitySystemSignatures.size()); entityId++) {
+		if (entitySystemSignatures[entityId].Contains(systemSignature)) {
+			system.AddEntityToSystem(GetEntity(EntityHandle(entityId, entityGenerations[entityId])));
+		}
 	}
 }
 
+void Registry::RunScheduledSystems() {
+	const int numSystems = static_cast<int>(scheduledSystems.size());
+
+	// Commands of a system are recorded with its position in the schedule, whichever thread runs it
+	const int firstSystemOrder = numScheduledSystemsRun + 1;
+	numScheduledSystemsRun += numSystems;
+	auto updateSystem = [this, firstSystemOrder](int index) {
+		CommandBuffer& commandBuffer = GetCommandBuffer();
+		const CommandBuffer::Origin origin = commandBuffer.origin;
+		commandBuffer.origin = { firstSystemOrder + index, 0, 0, 0 };
+		scheduledSystems[index].update();
+		commandBuffer.origin = origin;
+	};
+
+	if (!jobSystem) {
+		for (int i = 0; i < numSystems; i++) {
+			updateSystem(i);
+		}
+		scheduledSystems.clear();
+		return;
+	}
+
+	// Dependency graph, an edge from every system to the later systems it conflicts with
+	std::vector<std::vector<int>> dependents(numSystems);
+	std::unique_ptr<std::atomic<int>[]> numDependencies(new std::atomic<int>[numSystems]);
+	for (int j = 0; j < numSystems; j++) {
+		numDependencies[j].store(0, std::memory_order_relaxed);
+		for (int i = 0; i < j; i++) {
+			if (scheduledSystems[i].system->ConflictsWith(*scheduledSystems[j].system)) {
+				dependents[i].push_back(j);
+				numDependencies[j].fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// A finished system queues the dependents it was the last dependency of
+	// They are queued before the finished job is counted as done, so the counter can't reach zero early
+	JobCounter counter;
+	std::function<void(int)> runSystem = [&](int index) {
+		jobSystem->Run([&, index]() {
+			updateSystem(index);
+			for (int dependent : dependents[index]) {
+				if (numDependencies[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					runSystem(dependent);
+				}
+			}
+		}, &counter);
+	};
+	for (int i = 0; i < numSystems; i++) {
+		if (numDependencies[i].load(std::memory_order_relaxed) == 0) {
+			runSystem(i);
+		}
+	}
+	jobSystem->Wait(counter);
+
+	scheduledSystems.clear();
+}
+
+int Registry::AddTickGroup(double ticksPerSecond, int maxTicksPerFrame) {
+	TickGroup tickGroup;
+	tickGroup.stepTime = ticksPerSecond > 0.0 ? 1.0 / ticksPerSecond : 0.0;
+	tickGroup.maxTicksPerFrame = std::max(maxTicksPerFrame, 1);
+	tickGroups.push_back(std::move(tickGroup));
+	return static_cast<int>(tickGroups.size()) - 1;
+}
+
+void Registry::RunTickGroups(double deltaTime) {
+	for (TickGroup& tickGroup : tickGroups) {
+		if (tickGroup.stepTime == 0.0) {
+			for (auto& scheduleUpdate : tickGroup.scheduleUpdates) {
+				scheduleUpdate(deltaTime);
+			}
+			RunScheduledSystems();
+			continue;
+		}
+
+		tickGroup.accumulator += deltaTime;
+		int numTicks = 0;
+		while (tickGroup.accumulator >= tickGroup.stepTime && numTicks < tickGroup.maxTicksPerFrame) {
+			for (auto& scheduleUpdate : tickGroup.scheduleUpdates) {
+				scheduleUpdate(tickGroup.stepTime);
+			}
+			RunScheduledSystems();
+			tickGroup.accumulator -= tickGroup.stepTime;
+			numTicks++;
+		}
+
+		// Too far behind to catch up, drop the time instead of ticking more and more every frame
+		if (tickGroup.accumulator >= tickGroup.stepTime) {
+			tickGroup.accumulator = std::fmod(tickGroup.accumulator, tickGroup.stepTime);
+		}
+	}
+}
+
+void Registry::StampComponentTicks(int componentId, int entityId, bool isAdded) {
+	std::vector<ComponentTicks>& ticks = componentTicks[componentId];
+	if (entityId >= static_cast<int>(ticks.size())) {
+		ticks.resize(std::max(numEntities, entityId + 1));
+	}
+	const uint32_t tick = currentTick.load(std::memory_order_relaxed);
+	if (isAdded) {
+		ticks[entityId].added = tick;
+	}
+	ticks[entityId].changed = tick;
+}
+
+ComponentTicks Registry::GetComponentTicks(int componentId, int entityId) const {
+	const std::vector<ComponentTicks>& ticks = componentTicks[componentId];
+	return entityId < static_cast<int>(ticks.size()) ? ticks[entityId] : ComponentTicks();
+}
+
+void Registry::IncrementGeneration(int entityId) {
+	// Skip the value reserved for null handles
+	uint32_t generation = (entityGenerations[entityId] + 1) & ENTITY_GENERATION_MASK;
+	if (EntityHandle(entityId, generation).IsNull()) {
+		generation = 0;
+	}
+	entityGenerations.Mutable(entityId) = generation;
+}
+
+void Registry::IncrementComponentVersions(const Signature& signature) {
+	signature.ForEachSetBit([this](int componentId) {
+		componentVersions[componentId]++;
+	});
+}
+
 void Registry::Update() {
-	// Add entities that are waiting to be added to entities vector
-	for (auto entity : entitiesToBeAdded) {
-		AddEntityToSystems(entity);
+	PlaybackCommandBuffers();
+
+	if (entityCommands.empty()) {
+		NotifyObservers();
+		return;
 	}
-	entitiesToBeAdded.clear();
-	
-	// Remove entities that are waiting to be killed from entities vector
-	for (auto entity : entitiesToBeKilled) {
-		RemoveEntityFromSystems(entity);
-		int entityId = entity.GetId();
 
-		entityComponentSignatures[entityId].reset();
+	const bool isObserved = observedComponents.any();
+
+	// Group the commands by entity, keeping the order in which they were recorded for each entity
+	std::stable_sort(entityCommands.begin(), entityCommands.end(), [](const EntityCommand& a, const EntityCommand& b) {
+		return a.entity.GetIndex() < b.entity.GetIndex();
+	});
+
+	for (size_t first = 0; first < entityCommands.size();) {
+		const int entityId = entityCommands[first].entity.GetIndex();
+
+		bool isKilled = false;
+		Signature addedSignature;
+		size_t last = first;
+		for (; last < entityCommands.size() && entityCommands[last].entity.GetIndex() == entityId; last++) {
+			isKilled |= entityCommands[last].type == EntityCommandType::Kill;
+			if (entityCommands[last].type == EntityCommandType::AddComponent) {
+				addedSignature.set(entityCommands[last].componentId);
+			}
+		}
+		first = last;
+
+		const Entity entity = GetEntity(EntityHandle(entityId, entityGenerations[entityId]));
+
+		// Systems only need to know about the net change of the signature during the frame
+		const Signature newSignature = isKilled ? Signature() : entityComponentSignatures[entityId];
+		UpdateEntitySystems(entity, entitySystemSignatures[entityId], newSignature);
+		if (isObserved) {
+			RecordObservedChanges(entity, entitySystemSignatures[entityId], newSignature, addedSignature);
+		}
+		entitySystemSignatures.Mutable(entityId) = newSignature;
+
+		if (!isKilled) {
+			continue;
+		}
+
+		// Destroy the components of the entity so they dont take slots in the pools
+		IncrementComponentVersions(entityComponentSignatures[entityId]);
+		if (archetypeStorage) {
+			archetypeStorage->RemoveEntity(entityId);
+		}
+		for (auto& pool : componentPools) {
+			if (pool) {
+				pool->RemoveEntityFromPool(entityId);
+			}
+		}
+		(entityComponentSignatures[entityId] & sharedComponentTypes).ForEachSetBit([&](int componentId) {
+			sharedComponentPools[componentId]->RemoveEntityFromPool(entityId);
+		});
+
+		entityComponentSignatures.Mutable(entityId).reset();
+
+		RemoveEntityTag(entity);
+		RemoveEntityGroup(entity);
+
+		// The id starts out enabled when it is reused
+		if (!IsEntityEnabled(entityId)) {
+			SetEntityEnabled(entity, true);
+		}
+
+		// Invalidate all handles to the entity
+		IncrementGeneration(entityId);
 
 		// Make the entity id available for reuse
 		freeIds.push_back(entityId);
+		needsCompaction = true;
+	}
+	entityCommands.clear();
+
+	NotifyObservers();
+}
+
+void Registry::RecordReplacedComponent(int componentId, EntityHandle entity) {
+	if (observedComponents.test(componentId)) {
+		pendingComponentChanges[componentId].replaced.push_back(GetEntity(entity));
+		hasPendingReplacements = true;
+	}
+}
+
+void Registry::RecordObservedChanges(Entity entity, const Signature& oldSignature, const Signature& newSignature, const Signature& addedSignature) {
+	(oldSignature & observedComponents).ForEachSetBit([&](int componentId) {
+		if (!newSignature.test(componentId)) {
+			pendingComponentChanges[componentId].removed.push_back(entity);
+		}
+		else if (addedSignature.test(componentId)) {
+			// Removed and added again during the frame
+			pendingComponentChanges[componentId].replaced.push_back(entity);
+		}
+	});
+	(newSignature & observedComponents).ForEachSetBit([&](int componentId) {
+		if (!oldSignature.test(componentId)) {
+			pendingComponentChanges[componentId].added.push_back(entity);
+		}
+	});
+}
+
+void Registry::NotifyObservers() {
+	hasPendingReplacements = false;
+	observedComponents.ForEachSetBit([this](int componentId) {
+		// Observers may change components, those changes are collected for the next Update
+		ComponentChanges changes;
+		std::swap(changes, pendingComponentChanges[componentId]);
+
+		// Keep one replacement per entity, and only for entities that had the component before this frame and still have it
+		std::vector<Entity>& replaced = changes.replaced;
+		if (!replaced.empty()) {
+			std::sort(changes.added.begin(), changes.added.end());
+			std::sort(replaced.begin(), replaced.end());
+			replaced.erase(std::unique(replaced.begin(), replaced.end()), replaced.end());
+			replaced.erase(std::remove_if(replaced.begin(), replaced.end(), [&](const Entity& entity) {
+				return !IsAlive(entity.GetHandle()) || !entityComponentSignatures[entity.GetId()].test(componentId) ||
+					std::binary_search(changes.added.begin(), changes.added.end(), entity);
+			}), replaced.end());
+		}
+
+		if (!changes.IsEmpty()) {
+			for (const ObserverEntry& entry : componentObservers[componentId]) {
+				entry.observer(changes);
+			}
+		}
+
+		// Give the buffers back so their capacity is reused
+		ComponentChanges& pendingChanges = pendingComponentChanges[componentId];
+		if (pendingChanges.IsEmpty()) {
+			changes.added.clear();
+			changes.removed.clear();
+			changes.replaced.clear();
+			std::swap(changes, pendingChanges);
+		}
+		hasPendingReplacements |= !pendingChanges.replaced.empty();
+	});
+}
+
+int Registry::AddRemapObserver(RemapObserver observer) {
+	remapObservers.push_back({ nextObserverId, std::move(observer) });
+	return nextObserverId++;
+}
+
+void Registry::RemoveObserver(int observerId) {
+	auto remapObserver = std::find_if(remapObservers.begin(), remapObservers.end(), [observerId](const std::pair<int, RemapObserver>& entry) {
+		return entry.first == observerId;
+	});
+	if (remapObserver != remapObservers.end()) {
+		remapObservers.erase(remapObserver);
+		return;
+	}
+
+	for (size_t componentId = 0; componentId < componentObservers.size(); componentId++) {
+		std::vector<ObserverEntry>& observers = componentObservers[componentId];
+		auto entry = std::find_if(observers.begin(), observers.end(), [observerId](const ObserverEntry& entry) {
+			return entry.observerId == observerId;
+		});
+		if (entry == observers.end()) {
+			continue;
+		}
+
+		observers.erase(entry);
+		if (observers.empty()) {
+			// Nobody is left to consume the collected changes
+			observedComponents.set(static_cast<int>(componentId), false);
+			pendingComponentChanges[componentId] = ComponentChanges();
+		}
+		return;
+	}
+}
+
+bool Registry::Compact(int budget) {
+	if (!needsCompaction) {
+		return true;
+	}
+
+	// Pending commands and replacements still refer to the current ids
+	if (!entityCommands.empty() || hasPendingReplacements) {
+		return false;
+	}
+
+	// Free ids at the end are dropped, the others are filled with the entities with the highest ids
+	std::sort(freeIds.begin(), freeIds.end());
+	auto dropTrailingFreeIds = [this]() {
+		while (!freeIds.empty() && freeIds.back() == numEntities - 1) {
+			freeIds.pop_back();
+			numEntities--;
+		}
+	};
+
+	dropTrailingFreeIds();
+	const int previousBudget = budget;
+	while (budget > 0 && !freeIds.empty()) {
+		const int newEntityId = freeIds.front();
+		freeIds.pop_front();
+		RenumberEntity(numEntities - 1, newEntityId);
+		numEntities--;
+		budget--;
+		dropTrailingFreeIds();
+	}
+
+	// Stored handles are remapped before anything reads them again
+	if (budget != previousBudget) {
+		for (const auto& observer : remapObservers) {
+			observer.second(remappedHandles);
+		}
+	}
+	if (!freeIds.empty()) {
+		return false;
+	}
+
+	for (auto& pool : componentPools) {
+		if (pool) {
+			pool->Compact();
+		}
+	}
+
+	// No entity uses the ids past numEntities anymore, the generations keep them so stale handles stay dead
+	const size_t numEntityIds = static_cast<size_t>(numEntities);
+	entityComponentSignatures.resize(numEntityIds);
+	entityComponentSignatures.shrink_to_fit();
+	entitySystemSignatures.resize(numEntityIds);
+	entitySystemSignatures.shrink_to_fit();
+	for (auto& ticks : componentTicks) {
+		if (ticks.size() > numEntityIds) {
+			ticks.resize(numEntityIds);
+			ticks.shrink_to_fit();
+		}
+	}
+	if (entityGroupIds.size() > numEntityIds) {
+		entityGroupIds.resize(numEntityIds);
+		entityGroupIds.shrink_to_fit();
+		entityGroupIndices.resize(numEntityIds);
+		entityGroupIndices.shrink_to_fit();
+	}
+	disabledEntityBits.resize(std::min(disabledEntityBits.size(), (numEntityIds + 63) / 64));
+	for (System* system : systemList) {
+		system->ShrinkEntityIds(numEntities);
+	}
+
+	if (archetypeStorage) {
+		archetypeStorage->ReleaseEmptyArchetypes();
+	}
+
+	Logger::Log("Compacted registry to " + std::to_string(numEntities) + " entities");
+	needsCompaction = false;
+	remappedHandles.clear();
+	return true;
+}
+
+void Registry::RenumberEntity(int entityId, int newEntityId) {
+	const EntityHandle handle(entityId, entityGenerations[entityId]);
+	const EntityHandle newHandle(newEntityId, entityGenerations[newEntityId]);
+	const Signature signature = entityComponentSignatures[entityId];
+
+	IncrementComponentVersions(signature);
+	if (archetypeStorage) {
+		archetypeStorage->RemapEntity(entityId, newEntityId);
+	}
+	signature.ForEachSetBit([&](int componentId) {
+		if (componentId < static_cast<int>(componentPools.size()) && componentPools[componentId]) {
+			componentPools[componentId]->RemapEntity(entityId, newEntityId);
+		}
+		if (sharedComponentPools[componentId]) {
+			sharedComponentPools[componentId]->RemapEntity(entityId, newHandle);
+		}
+		std::vector<ComponentTicks>& ticks = componentTicks[componentId];
+		if (entityId < static_cast<int>(ticks.size())) {
+			ticks[newEntityId] = ticks[entityId];
+		}
+	});
+
+	entityComponentSignatures.Mutable(newEntityId) = signature;
+	entityComponentSignatures.Mutable(entityId).reset();
+	const Signature systemSignature = entitySystemSignatures[entityId];
+	entitySystemSignatures.Mutable(newEntityId) = systemSignature;
+	entitySystemSignatures.Mutable(entityId).reset();
+
+	for (System* system : systemList) {
+		system->RemapEntity(handle, newHandle);
+	}
+
+	auto tag = tagPerEntity.find(entityId);
+	if (tag != tagPerEntity.end()) {
+		const std::string tagName = tag->second;
+		tagPerEntity.erase(tag);
+		entityPerTag[tagName] = newHandle;
+		tagPerEntity[newEntityId] = tagName;
+	}
+
+	if (entityId < static_cast<int>(entityGroupIds.size()) && entityGroupIds[entityId] != -1) {
+		groupEntities[entityGroupIds[entityId]][entityGroupIndices[entityId]] = newHandle;
+		entityGroupIds[newEntityId] = entityGroupIds[entityId];
+		entityGroupIndices[newEntityId] = entityGroupIndices[entityId];
+		entityGroupIds[entityId] = -1;
+		entityGroupIndices[entityId] = -1;
+	}
+
+	// The free id the entity moves to is enabled, so only a disabled bit has to move
+	if (!IsEntityEnabled(entityId)) {
+		disabledEntityBits[entityId / 64] &= ~(uint64_t(1) << (entityId % 64));
+		const size_t word = newEntityId / 64;
+		if (word >= disabledEntityBits.size()) {
+			disabledEntityBits.resize(word + 1, 0);
+		}
+		disabledEntityBits[word] |= uint64_t(1) << (newEntityId % 64);
+	}
+
+	// Old handles must not resolve to whatever gets the id next
+	IncrementGeneration(entityId);
+
+	remappedHandles[handle.value] = newHandle;
+}
+
+EntityHandle Registry::GetRemappedHandle(EntityHandle handle) const {
+	// An entity renumbered by several Compact calls of the same compaction is followed to its latest handle
+	auto remapped = remappedHandles.find(handle.value);
+	while (remapped != remappedHandles.end()) {
+		handle = remapped->second;
+		remapped = remappedHandles.find(handle.value);
 	}
-	entitiesToBeKilled.clear();
+	return handle;
 }
\ No newline at end of file
@@ -2,78 +2,592 @@
 #define ECS_H
 
 #include "../Logger/Logger.h"
+#include "../JobSystem/JobSystem.h"
 #include <vector>
-#include <set>
-#include <bitset>
+#include <string>
+#include <functional>
 #include <unordered_map>
 #include <typeindex>
+#include <typeinfo>
+#include <cstddef>
+#include <cstring>
 #include <memory>
 #include <deque>
-
-const int MAX_COMPONENTS = 32;
+#include <cstdint>
+#include <tuple>
+#include <new>
+#include <algorithm>
+#include <type_traits>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ECS_SIGNATURE_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Maximum number of component types, must be a multiple of 128
+// Define ECS_MAX_COMPONENTS in the project settings to change it (e.g. 256)
+#ifndef ECS_MAX_COMPONENTS
+#define ECS_MAX_COMPONENTS 128
+#endif
+
+const int MAX_COMPONENTS = ECS_MAX_COMPONENTS;
+
+static_assert(MAX_COMPONENTS % 128 == 0, "MAX_COMPONENTS must be a multiple of 128");
 
 // Signature
 // A bitset to keep track of what components an entity has
 // and also to know which components a system is interested in
-typedef std::bitset<MAX_COMPONENTS> Signature;
+// Matching is vectorized with AVX2 or SSE2 when the compiler targets them
+class alignas(32) Signature {
+private:
+	static const int NUM_WORDS = MAX_COMPONENTS / 64;
+
+	uint64_t words[NUM_WORDS] = {};
+
+	static int CountTrailingZeros(uint64_t bits) {
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64(&index, bits);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctzll(bits);
+#endif
+	}
+
+public:
+	Signature() = default;
+
+	void set(int bit, bool value = true) {
+		if (value) {
+			words[bit / 64] |= uint64_t(1) << (bit % 64);
+		}
+		else {
+			words[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+		}
+	}
+
+	bool test(int bit) const {
+		return (words[bit / 64] >> (bit % 64)) & 1;
+	}
+
+	void reset() {
+		for (int i = 0; i < NUM_WORDS; i++) {
+			words[i] = 0;
+		}
+	}
+
+	bool any() const {
+		for (int i = 0; i < NUM_WORDS; i++) {
+			if (words[i]) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool none() const {
+		return !any();
+	}
+
+	// True if every bit of the other signature is also set in this one
+	bool Contains(const Signature& other) const {
+#if defined(__AVX2__) && ECS_MAX_COMPONENTS % 256 == 0
+		for (int i = 0; i < NUM_WORDS; i += 4) {
+			const __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(words + i));
+			const __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(other.words + i));
+			// testc is set when (~a & b) == 0
+			if (!_mm256_testc_si256(a, b)) {
+				return false;
+			}
+		}
+		return true;
+#elif defined(ECS_SIGNATURE_SSE2)
+		for (int i = 0; i < NUM_WORDS; i += 2) {
+			const __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(words + i));
+			const __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(other.words + i));
+			const __m128i equal = _mm_cmpeq_epi32(_mm_and_si128(a, b), b);
+			if (_mm_movemask_epi8(equal) != 0xFFFF) {
+				return false;
+			}
+		}
+		return true;
+#else
+		for (int i = 0; i < NUM_WORDS; i++) {
+			if ((words[i] & other.words[i]) != other.words[i]) {
+				return false;
+			}
+		}
+		return true;
+#endif
+	}
+
+	// True if at least one bit is set in both signatures
+	bool Intersects(const Signature& other) const {
+		for (int i = 0; i < NUM_WORDS; i++) {
+			if (words[i] & other.words[i]) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Calls func(bit) for every set bit, in increasing order
+	template <typename TFunc>
+	void ForEachSetBit(TFunc&& func) const {
+		for (int i = 0; i < NUM_WORDS; i++) {
+			uint64_t bits = words[i];
+			while (bits) {
+				func(i * 64 + CountTrailingZeros(bits));
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	Signature operator &(const Signature& other) const {
+		Signature result;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			result.words[i] = words[i] & other.words[i];
+		}
+		return result;
+	}
+
+	Signature operator |(const Signature& other) const {
+		Signature result;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			result.words[i] = words[i] | other.words[i];
+		}
+		return result;
+	}
+
+	bool operator ==(const Signature& other) const {
+		for (int i = 0; i < NUM_WORDS; i++) {
+			if (words[i] != other.words[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool operator !=(const Signature& other) const {
+		return !(*this == other);
+	}
+
+	size_t GetHash() const {
+		size_t hash = 0;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			hash ^= std::hash<uint64_t>()(words[i]) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		}
+		return hash;
+	}
+
+	std::string to_string() const {
+		std::string result(MAX_COMPONENTS, '0');
+		ForEachSetBit([&result](int bit) {
+			result[MAX_COMPONENTS - 1 - bit] = '1';
+		});
+		return result;
+	}
+};
+
+namespace std {
+	template <>
+	struct hash<Signature> {
+		size_t operator ()(const Signature& signature) const {
+			return signature.GetHash();
+		}
+	};
+}
+
+// TriviallyRelocatable
+// Specialize with std::true_type for component types that can be moved with memcpy
+// even though they are not trivially copyable, the source is then dropped without calling its destructor
+template <typename T>
+struct TriviallyRelocatable : std::is_trivially_copyable<T> {};
+
+// ColdComponent
+// Specialize to keep the rarely used fields of a component type in a companion component type with its own storage,
+// so loops over the hot part dont pull the cold fields into the cache
+// The cold part is added with its default value when the hot part is added to an entity that doesnt have it yet,
+// and removed together with the hot part
+// Example: template <> struct ColdComponent<SpriteComponent> { typedef SpriteColdComponent Type; };
+template <typename T>
+struct ColdComponent {
+	typedef void Type;
+};
+
+template <typename T>
+struct HasColdComponent : std::negation<std::is_void<typename ColdComponent<T>::Type>> {};
+
+// Member of a component type, see COMPONENT_FIELD
+struct ComponentFieldInfo {
+	std::string name;
+	size_t offset = 0;
+	size_t size = 0;
+};
+
+// Describes a member of a component type for DescribeComponentType
+// Example: COMPONENT_FIELD(TransformComponent, position)
+#define COMPONENT_FIELD(TComponent, field) ComponentFieldInfo{ #field, offsetof(TComponent, field), sizeof(TComponent::field) }
+
+// ComponentTypeInfo
+// Runtime description of a component type, filled in when the type gets its id
+// Type erased code copies, moves and destroys components through it, with memcpy for the trivial types
+struct ComponentTypeInfo {
+	std::string name;
+	size_t size = 0;
+	size_t alignment = 0;
+	bool isTriviallyCopyable = false;
+	bool isTriviallyRelocatable = false;
+	bool isTriviallyDestructible = false;
+
+	// Component id of the cold part of the type, -1 if the type isnt split
+	int coldComponentId = -1;
+
+	// Empty unless the type was described with DescribeComponentType
+	std::vector<ComponentFieldInfo> fields;
+
+	// Null if the type is not copy constructible
+	void (*copyConstruct)(void* destination, const void* source) = nullptr;
+	void (*moveConstruct)(void* destination, void* source) = nullptr;
+	void (*destroy)(void* object) = nullptr;
+
+	// Copy constructs count contiguous components into uninitialized memory
+	void CopyConstruct(void* destination, const void* source, int count = 1) const;
+
+	// Moves count contiguous components into uninitialized memory and destroys the sources
+	void Relocate(void* destination, void* source, int count = 1) const;
+
+	void Destroy(void* object, int count = 1) const;
+};
 
 struct IComponent {
 protected:
-	static int nextId;
+	static std::atomic<int> nextId;
+
+	// Taken while a component type gets its id, recursive since registering a type can give its cold type an id
+	static std::recursive_mutex& IdMutex();
+
+	// Vector index is the component id, allocated once so the infos never move
+	static std::vector<ComponentTypeInfo>& TypeInfos();
+
+	template <typename T> static void RegisterTypeInfo(int componentId);
+
+	template <typename ...TComponents> friend void RegisterComponentTypes();
+	template <typename TComponent> friend void DescribeComponentType(const std::string& name, std::vector<ComponentFieldInfo> fields);
+	friend const ComponentTypeInfo& GetComponentTypeInfo(int componentId);
 };
 
 template <typename T>
 class Component : public IComponent {
+private:
+	static std::atomic<int>& Id() {
+		static std::atomic<int> id{ -1 };
+		return id;
+	}
+
+	template <typename ...TComponents> friend void RegisterComponentTypes();
+
 public:
 	static int GetID() {
-		// Each new component type will have a unique id
-		static int id = nextId++;
-		return id;
+		// Each new component type will have a unique id, systems on worker threads may ask for it first
+		std::atomic<int>& id = Id();
+		int componentId = id.load(std::memory_order_acquire);
+		if (componentId == -1) {
+			std::lock_guard<std::recursive_mutex> lock(IdMutex());
+			componentId = id.load(std::memory_order_relaxed);
+			if (componentId == -1) {
+				componentId = nextId++;
+				RegisterTypeInfo<T>(componentId);
+				id.store(componentId, std::memory_order_release);
+			}
+		}
+		return componentId;
+	}
+};
+
+template <typename T>
+void IComponent::RegisterTypeInfo(int componentId) {
+	// Signatures and pools are sized for MAX_COMPONENTS, a larger id would corrupt them
+	if (componentId >= MAX_COMPONENTS) {
+		Logger::Err("Too many component types, increase ECS_MAX_COMPONENTS.");
+		std::abort();
+	}
+
+	ComponentTypeInfo& info = TypeInfos()[componentId];
+	info.name = typeid(T).name();
+	info.size = sizeof(T);
+	info.alignment = alignof(T);
+	info.isTriviallyCopyable = std::is_trivially_copyable<T>::value;
+	info.isTriviallyRelocatable = TriviallyRelocatable<T>::value;
+	info.isTriviallyDestructible = std::is_trivially_destructible<T>::value;
+	if constexpr (HasColdComponent<T>::value) {
+		info.coldComponentId = Component<typename ColdComponent<T>::Type>::GetID();
+	}
+	if constexpr (std::is_copy_constructible<T>::value) {
+		info.copyConstruct = [](void* destination, const void* source) {
+			new (destination) T(*static_cast<const T*>(source));
+		};
+	}
+	info.moveConstruct = [](void* destination, void* source) {
+		new (destination) T(std::move(*static_cast<T*>(source)));
+	};
+	info.destroy = [](void* object) {
+		static_cast<T*>(object)->~T();
+	};
+}
+
+// Assigns component ids in the order of the template arguments
+// Call it once at startup, before any component type is used,
+// so the ids dont depend on the order in which components are first used
+template <typename ...TComponents>
+void RegisterComponentTypes() {
+	if (IComponent::nextId != 0) {
+		Logger::Err("Component types must be registered before any component is used.");
+		return;
+	}
+	((Component<TComponents>::Id().store(IComponent::nextId++, std::memory_order_release)), ...);
+	(IComponent::RegisterTypeInfo<TComponents>(Component<TComponents>::Id()), ...);
+}
+
+// Gives a component type a readable name and lists its members for tools and serialization
+// Example: DescribeComponentType<RigidBodyComponent>("RigidBodyComponent", { COMPONENT_FIELD(RigidBodyComponent, velocity) });
+template <typename TComponent>
+void DescribeComponentType(const std::string& name, std::vector<ComponentFieldInfo> fields) {
+	ComponentTypeInfo& info = IComponent::TypeInfos()[Component<TComponent>::GetID()];
+	info.name = name;
+	info.fields = std::move(fields);
+}
+
+const ComponentTypeInfo& GetComponentTypeInfo(int componentId);
+
+template <typename TComponent>
+const ComponentTypeInfo& GetComponentTypeInfo() {
+	return GetComponentTypeInfo(Component<TComponent>::GetID());
+}
+
+// Number of bits of an entity handle used for the entity index, the rest stores the generation
+const int ENTITY_INDEX_BITS = 20;
+const uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+const uint32_t ENTITY_GENERATION_MASK = (1u << (32 - ENTITY_INDEX_BITS)) - 1;
+const int MAX_ENTITIES = ENTITY_INDEX_MASK;
+
+// EntityHandle
+// Entity index and generation packed in 32 bits
+// The generation is bumped every time an index is reused, so stale handles can be detected
+struct EntityHandle {
+	uint32_t value = 0xFFFFFFFF;
+
+	EntityHandle() = default;
+	EntityHandle(int index, uint32_t generation) :
+		value((static_cast<uint32_t>(index) & ENTITY_INDEX_MASK) | ((generation & ENTITY_GENERATION_MASK) << ENTITY_INDEX_BITS)) {}
+
+	int GetIndex() const {
+		return static_cast<int>(value & ENTITY_INDEX_MASK);
+	}
+
+	uint32_t GetGeneration() const {
+		return value >> ENTITY_INDEX_BITS;
+	}
+
+	bool IsNull() const {
+		return value == 0xFFFFFFFF;
+	}
+
+	bool operator ==(const EntityHandle& other) const {
+		return value == other.value;
+	}
+
+	bool operator !=(const EntityHandle& other) const {
+		return value != other.value;
+	}
+
+	bool operator <(const EntityHandle& other) const {
+		return value < other.value;
 	}
 };
 
 class Entity {
 private:
-	int id;
+	EntityHandle handle;
 public:
-	Entity(int id) : id(id) {}
+	Entity(EntityHandle handle) : handle(handle) {}
 	int GetId() const;
+	EntityHandle GetHandle() const;
 
 	// Overload the == operator to compare entities
 	bool operator ==(const Entity& other) const {
-		return id == other.id;
+		return handle == other.handle;
 	}
 
 	bool operator !=(const Entity& other) const {
-		return !(id == other.id);
+		return handle != other.handle;
 	}
 
 	// Set insert requieres the insterted object to work with < comparison
 	bool operator <(const Entity& other) const {
-		return id < other.id;
+		return handle < other.handle;
 	}
 
 	bool operator >(const Entity& other) const {
-		return id > other.id;
+		return other.handle < handle;
 	}
 
 	void Kill();
+	bool IsAlive() const;
+
+	// Disabled entities keep their components but are skipped by views and systems
+	void Enable();
+	void Disable();
+	bool IsEnabled() const;
+
+	// Tags and groups
+	void Tag(const std::string& tag);
+	bool HasTag(const std::string& tag) const;
+	void Group(const std::string& group);
+	bool BelongsToGroup(const std::string& group) const;
 
 	template<typename TComponent, typename ...TArgs> void AddComponent(TArgs&& ...args);
 	template<typename TComponent> void RemoveComponent();
 	template<typename TComponent> bool HasComponent() const;
 	template<typename TComponent> TComponent& GetComponent() const;
+	template<typename TComponent> typename ColdComponent<TComponent>::Type& GetColdComponent() const;
+	// Read only access, doesnt count as a write for forked registries
+	template<typename TComponent> const TComponent& ReadComponent() const;
+	template<typename TComponent> const typename ColdComponent<TComponent>::Type& ReadColdComponent() const;
+	template<typename TComponent, typename ...TArgs> void AddSharedComponent(TArgs&& ...args);
+	template<typename TComponent> void RemoveSharedComponent();
+	template<typename TComponent> const TComponent& GetSharedComponent() const;
+	template<typename TComponent> void MarkChanged() const;
+	template<typename TComponent> bool HasChanged(uint32_t sinceTick) const;
 
 	// Forward declaration
 	class Registry* registry;
 };
 
+// EntitySpan
+// Read only view over a contiguous array of entity handles, nothing is copied
+// Dereferencing an iterator gives an Entity bound to the registry
+class EntitySpan {
+private:
+	const EntityHandle* first;
+	const EntityHandle* last;
+	class Registry* registry;
+
+public:
+	class Iterator {
+	private:
+		const EntityHandle* handle;
+		class Registry* registry;
+
+	public:
+		Iterator(const EntityHandle* handle, class Registry* registry) : handle(handle), registry(registry) {}
+
+		Entity operator *() const {
+			Entity entity(*handle);
+			entity.registry = registry;
+			return entity;
+		}
+
+		Iterator& operator ++() {
+			handle++;
+			return *this;
+		}
+
+		Iterator operator ++(int) {
+			Iterator previous = *this;
+			handle++;
+			return previous;
+		}
+
+		Iterator operator +(int offset) const {
+			return Iterator(handle + offset, registry);
+		}
+
+		int operator -(const Iterator& other) const {
+			return static_cast<int>(handle - other.handle);
+		}
+
+		bool operator ==(const Iterator& other) const {
+			return handle == other.handle;
+		}
+
+		bool operator !=(const Iterator& other) const {
+			return handle != other.handle;
+		}
+	};
+
+	EntitySpan(const EntityHandle* first, const EntityHandle* last, class Registry* registry) : first(first), last(last), registry(registry) {}
+
+	Iterator begin() const {
+		return Iterator(first, registry);
+	}
+
+	Iterator end() const {
+		return Iterator(last, registry);
+	}
+
+	int size() const {
+		return static_cast<int>(last - first);
+	}
+
+	bool empty() const {
+		return first == last;
+	}
+
+	Entity operator [](int index) const {
+		return *(begin() + index);
+	}
+
+	const EntityHandle* GetHandles() const {
+		return first;
+	}
+
+	// Calls func(entity) for every entity, split across the job system of the registry
+	template <typename TFunc> void ParallelEach(TFunc&& func, int grainSize = DEFAULT_GRAIN_SIZE) const;
+};
+
 // System
 // Process entities that contain a specific signature
 class System {
 private:
 	Signature componentSignature;
-	std::vector<Entity> entities;
+
+	// Component types the system reads and writes in its update
+	Signature readSignature;
+	Signature writeSignature;
+
+	// Dense array of the entities in the system, the enabled ones first
+	std::vector<EntityHandle> entities;
+	int numEnabledEntities = 0;
+
+	// Entity id to index in the entities vector, -1 if the entity is not in the system
+	std::vector<int> entityIdToIndex;
+
+	// Bumped whenever an entity enters or leaves the system, or is enabled or disabled
+	uint32_t membershipVersion = 0;
+
+	// Time slicing, position in the enabled entities where the next slice starts
+	int numTimeSlices = 1;
+	double timeBudgetMilliseconds = 0.0;
+	int timeSliceCursor = 0;
+
+	void SwapEntities(int index, int otherIndex);
+
+protected:
+	// Registry that owns the system, set when the system is added
+	class Registry* registry = nullptr;
+
+	friend class Registry;
 
 public:
 	System() = default;
@@ -81,11 +595,42 @@ public:
 
 	void AddEntityToSystem(Entity entity);
 	void RemoveEntityFromSystem(Entity entity);
-	std::vector<Entity> GetSystemEntities() const;
+	bool HasEntity(Entity entity) const;
+
+	// Only the enabled entities, disabled entities stay members of the system
+	EntitySpan GetSystemEntities() const;
+
+	// Enabled and disabled entities, the enabled ones first
+	EntitySpan GetAllSystemEntities() const;
 	const Signature& GetComponentSignature() const;
+	uint32_t GetMembershipVersion() const;
 
 	// Defines the component type that entities must have to be constidered by the system
 	template <typename TComponent> void RequireComponent();
+
+	// Declares the component types the system update accesses, the scheduler runs systems that don't conflict at the same time
+	// A system that declares nothing is assumed to touch everything
+	template <typename TComponent> void ReadsComponent();
+	template <typename TComponent> void WritesComponent();
+
+	// True if one system writes a component type the other one reads or writes
+	bool ConflictsWith(const System& other) const;
+
+	// Replaces the handle of an entity renumbered by Registry::Compact, keeping its position
+	void RemapEntity(EntityHandle entity, EntityHandle newEntity);
+
+	// Moves the entity to the other side of the enabled entities
+	void SetEntityEnabled(Entity entity, bool isEnabled);
+
+	// Forgets the entity ids from numEntityIds on, called by Registry::Compact once no entity uses them
+	void ShrinkEntityIds(int numEntityIds);
+
+	// Spreads the entities over numSlices ticks, a tick also stops once it used up budgetMilliseconds (0 for no budget)
+	void SetTimeSlicing(int numSlices, double budgetMilliseconds = 0.0);
+
+	// Calls func(entity) for the next slice of the enabled entities, round robin from where the previous tick stopped
+	// Returns the number of entities processed
+	template <typename TFunc> int ForEachTimeSlicedEntity(TFunc&& func);
 };
 
 template <typename TComponent>
@@ -94,175 +639,1774 @@ void System::RequireComponent() {
 	componentSignature.set(componentId);
 }
 
-// Pool
-// Vector that contains objects of a specific type
-class IPool {
-public:
-	virtual ~IPool() = default;
+template <typename TComponent>
+void System::ReadsComponent() {
+	readSignature.set(Component<TComponent>::GetID());
+}
 
-};
+template <typename TComponent>
+void System::WritesComponent() {
+	writeSignature.set(Component<TComponent>::GetID());
+}
+
+// Number of entities a time sliced system processes between two checks of its budget
+const int TIME_SLICE_BUDGET_CHECK_INTERVAL = 32;
+
+template <typename TFunc>
+int System::ForEachTimeSlicedEntity(TFunc&& func) {
+	const EntitySpan systemEntities = GetSystemEntities();
+	const int numEntities = systemEntities.size();
+	if (numEntities == 0) {
+		return 0;
+	}
+
+	// Entities entering or leaving the system shift the positions, so an entity may be skipped or visited twice in a round
+	if (timeSliceCursor >= numEntities) {
+		timeSliceCursor = 0;
+	}
+	const int sliceSize = (numEntities + numTimeSlices - 1) / numTimeSlices;
+	const auto start = std::chrono::steady_clock::now();
+
+	int numProcessed = 0;
+	while (numProcessed < sliceSize) {
+		func(systemEntities[timeSliceCursor]);
+		numProcessed++;
+		if (++timeSliceCursor == numEntities) {
+			timeSliceCursor = 0;
+		}
+
+		if (timeBudgetMilliseconds > 0.0 && numProcessed % TIME_SLICE_BUDGET_CHECK_INTERVAL == 0) {
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			if (elapsed.count() >= timeBudgetMilliseconds) {
+				break;
+			}
+		}
+	}
+	return numProcessed;
+}
+
+// Number of components in one page of a pool, pages are allocated on demand and never move
+const int POOL_PAGE_SIZE = 1024;
+
+// Number of entity ids in one page of the sparse part of a pool
+const int POOL_SPARSE_PAGE_SIZE = 4096;
+
+// Number of values in one page of a CopyOnWriteArray
+const int COPY_ON_WRITE_PAGE_SIZE = 1024;
 
+// CopyOnWriteArray
+// Growable array split in fixed size pages, copies of the array share the pages until one of them writes to a page
+// Values are read with [] and written through Mutable, which copies the page first if it is shared
+// Only structural changes write to these arrays, so a copy is never written by several threads at once
 template <typename T>
-class Pool : public IPool {
+class CopyOnWriteArray {
 private:
-	std::vector<T> data;
+	std::vector<std::shared_ptr<T[]>> pages;
+	size_t count = 0;
 
 public:
-	Pool(int size = 100) {
-		data.resize(size);
+	size_t size() const {
+		return count;
 	}
 
-	virtual ~Pool() = default;
+	// Shrinking keeps the pages, the values are reset when the array grows again
+	void resize(size_t newSize, const T& value = T()) {
+		const size_t numPages = (newSize + COPY_ON_WRITE_PAGE_SIZE - 1) / COPY_ON_WRITE_PAGE_SIZE;
+		const size_t numFilledPages = pages.size();
+		while (pages.size() < numPages) {
+			pages.push_back(std::shared_ptr<T[]>(new T[COPY_ON_WRITE_PAGE_SIZE]));
+			std::fill(pages.back().get(), pages.back().get() + COPY_ON_WRITE_PAGE_SIZE, value);
+		}
+		for (size_t index = count; index < std::min(newSize, numFilledPages * COPY_ON_WRITE_PAGE_SIZE); index++) {
+			Mutable(index) = value;
+		}
+		count = newSize;
+	}
 
-	bool IsEmpty() const {
-		return data.empty();
+	const T& operator [](size_t index) const {
+		return pages[index / COPY_ON_WRITE_PAGE_SIZE][index % COPY_ON_WRITE_PAGE_SIZE];
 	}
 
-	int GetSize() const {
-		return data.size();
+	void push_back(const T& value) {
+		resize(count + 1, value);
 	}
 
-	void Resize(int size) {
-		data.resize(size);
+	void pop_back() {
+		count--;
 	}
 
-	void Clear() {
-		data.clear();
+	void clear() {
+		pages.clear();
+		count = 0;
 	}
 
-	void Add(T object) {
-		data.push_back(object);
+	// Releases the pages past the last value
+	void shrink_to_fit() {
+		pages.resize((count + COPY_ON_WRITE_PAGE_SIZE - 1) / COPY_ON_WRITE_PAGE_SIZE);
 	}
 
-	void Set(int index, T object) {
-		data[index] = object;
+	T& Mutable(size_t index) {
+		std::shared_ptr<T[]>& page = pages[index / COPY_ON_WRITE_PAGE_SIZE];
+		if (page.use_count() > 1) {
+			std::shared_ptr<T[]> copy(new T[COPY_ON_WRITE_PAGE_SIZE]);
+			std::copy(page.get(), page.get() + COPY_ON_WRITE_PAGE_SIZE, copy.get());
+			page = std::move(copy);
+		}
+		return page[index % COPY_ON_WRITE_PAGE_SIZE];
 	}
+};
+
+// StableComponent
+// Specialize with std::true_type for component types whose address must not change while they are alive
+// Removing such a component leaves a hole that the next added component reuses,
+// instead of moving the last component of the pool into it
+template <typename T>
+struct StableComponent : std::false_type {};
 
-	T& Get(int index) {
-		return static_cast<T&>(data[index]);
+// Pool
+// Sparse set that contains objects of a specific type
+// Components are packed in fixed size pages, the sparse pages map entity ids to dense indices
+// Growing the pool never moves existing components
+class IPool {
+public:
+	virtual ~IPool() = default;
+	virtual int GetSize() const = 0;
+	// Returns -1 for holes left by removed stable components
+	virtual int GetEntityId(int index) const = 0;
+	virtual void RemoveEntityFromPool(int entityId) = 0;
+
+	// Gives the component of an entity to another entity id, the component itself stays in place
+	virtual void RemapEntity(int entityId, int newEntityId) = 0;
+
+	// Adds a copy of the component of an entity to another entity id
+	virtual void CopyComponent(int entityId, int newEntityId) = 0;
+
+	// New pool that borrows the pages of this one until either of them writes to a page
+	// This pool keeps its pages in place, it hands the fork a copy of a page before writing to it
+	// Returns null if the component type cannot be copied
+	virtual std::shared_ptr<IPool> Fork() = 0;
+
+	// Releases the pages past the last component and the sparse pages without entities, components never move
+	// Only stable pools have holes, removing from the other pools already moves the last component into the hole
+	// Holes at the end of a stable pool are dropped, the others stay until Set reuses them
+	virtual void Compact() = 0;
+
+	// True while the pool shares pages with a forked pool, components may then be read from a page the writer no longer uses
+	bool SharesPages() const {
+		return numSharedPages.load(std::memory_order_acquire) != 0;
 	}
 
-	T& operator [](int index) const {
-		return Get(index);
+	// Changes when the pool replaces a borrowed page with its own copy, pointers into the borrowed page are stale then
+	uint32_t GetPageVersion() const {
+		return pageVersion.load(std::memory_order_acquire);
 	}
+
+protected:
+	// Owned pages that forks borrow and pages borrowed from the pool this one was forked from
+	std::atomic<int> numSharedPages{ 0 };
+	std::atomic<uint32_t> pageVersion{ 0 };
 };
 
-// Registry
-// Manages creation and destruction of entities,
-// adding systems and components
-class Registry {
+template <typename T>
+class Pool : public IPool {
 private:
-	int numEntities = 0;
+	struct Page;
+
+	// Page that forked pools borrow from the pool that owns it
+	// The owner keeps its page and writes to it in place, before its first write the borrowers get a frozen copy
+	struct PageShare {
+		// Number of borrowing pools, plus one while the owner has not written to the page yet
+		std::atomic<int> refCount{ 1 };
+		Page* page;
+		// Copy of the page made when the owner first wrote to it, null until then
+		std::atomic<Page*> frozenPage{ nullptr };
+		// Used slots of the frozen copy, destroyed with it
+		std::vector<int> usedSlots;
+
+		PageShare(Page* page) : page(page) {}
+
+		Page* GetContent() const {
+			Page* frozen = frozenPage.load(std::memory_order_acquire);
+			return frozen ? frozen : page;
+		}
+	};
+
+	struct Page {
+		// Set while forked pools borrow the page, only on pages this pool owns
+		std::atomic<PageShare*> share{ nullptr };
+		// Starts on its own cache line, so parallel for ranges over the slots of a page never write to the same line
+		alignas(CACHE_LINE_SIZE) alignas(T) unsigned char bytes[sizeof(T) * POOL_PAGE_SIZE];
+	};
+
+	// Page of the pool, either owned or borrowed from the pool this one was forked from
+	// A writer swaps a borrowed page for its own copy while other threads read through it
+	struct PageRef {
+		std::atomic<Page*> page;
+		// Null for owned pages
+		std::atomic<PageShare*> share;
+
+		PageRef(Page* page, PageShare* share = nullptr) : page(page), share(share) {}
+		PageRef(PageRef&& other) noexcept : page(other.page.load(std::memory_order_relaxed)), share(other.share.load(std::memory_order_relaxed)) {}
+	};
+
+	// Packed components, the dense index selects the page and the slot inside it
+	std::vector<PageRef> pages;
+
+	// Taken by threads copying a shared page, so every page is copied once
+	std::mutex shareMutex;
+
+	// Borrowed pages this pool replaced with its own copies, other threads may still read through them
+	// They are released when the pool is compacted, cleared or forked, which never runs next to systems
+	std::vector<PageShare*> retiredShares;
+
+	// Number of used dense slots, including holes
+	int size = 0;
+
+	// Dense index to entity id, -1 for holes
+	CopyOnWriteArray<int> indexToEntityId;
+
+	// Entity id to dense index, -1 if the entity doesnt have the component
+	// Pages are only allocated for ranges of ids that have the component, forked pools share them until one of them writes
+	std::vector<std::shared_ptr<int[]>> sparsePages;
+
+	// Holes left by removed stable components
+	std::vector<int> freeIndices;
+
+	// Reading never copies a page, borrowed pages are read through their share
+	Page* GetPage(int pageIndex) const {
+		const PageRef& pageRef = pages[pageIndex];
+		PageShare* share = pageRef.share.load(std::memory_order_acquire);
+		return share ? share->GetContent() : pageRef.page.load(std::memory_order_acquire);
+	}
 
-	// Vector of component pools. Each pool contains all instances of a specific component type
-	// Vector index is the component id
-	// Pool index is the entity id
-	std::vector<std::shared_ptr<IPool>> componentPools;
+	T* GetSlot(int index) const {
+		return reinterpret_cast<T*>(GetPage(index / POOL_PAGE_SIZE)->bytes) + index % POOL_PAGE_SIZE;
+	}
 
-	// Vector of component signatures used by entities
-	// Vector index is the entity id
-	std::vector<Signature> entityComponentSignatures;
+	// Slot that may be written, only checks the page while the pool shares pages with a forked pool
+	T* GetWritableSlot(int index) {
+		const int pageIndex = index / POOL_PAGE_SIZE;
+		Page* page = numSharedPages.load(std::memory_order_acquire) == 0 ? pages[pageIndex].page.load(std::memory_order_acquire) : GetWritablePage(pageIndex);
+		return reinterpret_cast<T*>(page->bytes) + index % POOL_PAGE_SIZE;
+	}
 
-	std::unordered_map<std::type_index, std::shared_ptr<System>> systems;
+	Page* GetWritablePage(int pageIndex) {
+		PageRef& pageRef = pages[pageIndex];
+		if (!pageRef.share.load(std::memory_order_acquire)) {
+			Page* page = pageRef.page.load(std::memory_order_acquire);
+			if (!page->share.load(std::memory_order_acquire)) {
+				return page;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(shareMutex);
+		if (PageShare* share = pageRef.share.load(std::memory_order_acquire)) {
+			// Borrowed page, this pool writes to its own copy from now on
+			// The page is stored before the share is cleared, readers that see no share see the copy
+			Page* copy = CopyPage(share->GetContent(), pageIndex);
+			pageRef.page.store(copy, std::memory_order_release);
+			pageRef.share.store(nullptr, std::memory_order_release);
+			retiredShares.push_back(share);
+			pageVersion.fetch_add(1, std::memory_order_release);
+			numSharedPages.fetch_sub(1, std::memory_order_release);
+			return copy;
+		}
+		Page* page = pageRef.page.load(std::memory_order_acquire);
+		if (PageShare* share = page->share.load(std::memory_order_acquire)) {
+			FreezePage(page, share, pageIndex);
+		}
+		return page;
+	}
 
-	//Sets of entities to be added and killed in the next frame
-	std::set<Entity> entitiesToBeAdded;
-	std::set<Entity> entitiesToBeKilled;
+	// Gives the borrowers of an owned page a copy of its current content, the page itself stays in place
+	void FreezePage(Page* page, PageShare* share, int pageIndex) {
+		if (share->refCount.load(std::memory_order_acquire) > 1) {
+			if constexpr (!std::is_trivially_destructible<T>::value) {
+				const int end = std::min(size, (pageIndex + 1) * POOL_PAGE_SIZE);
+				for (int index = pageIndex * POOL_PAGE_SIZE; index < end; index++) {
+					if (indexToEntityId[index] != -1) {
+						share->usedSlots.push_back(index % POOL_PAGE_SIZE);
+					}
+				}
+			}
+			share->frozenPage.store(CopyPage(page, pageIndex), std::memory_order_release);
+		}
+		page->share.store(nullptr, std::memory_order_release);
+		numSharedPages.fetch_sub(1, std::memory_order_release);
+		ReleaseShare(share);
+	}
 
-	// Queue of free entity ids that were previously removed
-	std::deque<int> freeIds;
+	// Pools only share pages of copyable types, see Fork
+	// Pools that share a page agree on which of its slots are used, changing that writes to the page first
+	Page* CopyPage(const Page* page, int pageIndex) const {
+		Page* copy = new Page;
+		if constexpr (std::is_trivially_copyable<T>::value) {
+			std::memcpy(copy->bytes, page->bytes, sizeof(page->bytes));
+		}
+		else if constexpr (std::is_copy_constructible<T>::value) {
+			const int end = std::min(size, (pageIndex + 1) * POOL_PAGE_SIZE);
+			for (int index = pageIndex * POOL_PAGE_SIZE; index < end; index++) {
+				if (indexToEntityId[index] != -1) {
+					new (reinterpret_cast<T*>(copy->bytes) + index % POOL_PAGE_SIZE) T(reinterpret_cast<const T*>(page->bytes)[index % POOL_PAGE_SIZE]);
+				}
+			}
+		}
+		return copy;
+	}
 
+	// Drops one reference to a share, the last one destroys the frozen copy
+	static void ReleaseShare(PageShare* share) {
+		if (share->refCount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+			return;
+		}
+		if (Page* frozen = share->frozenPage.load(std::memory_order_acquire)) {
+			if constexpr (!std::is_trivially_destructible<T>::value) {
+				for (int slot : share->usedSlots) {
+					reinterpret_cast<T*>(frozen->bytes)[slot].~T();
+				}
+			}
+			delete frozen;
+		}
+		delete share;
+	}
 
-public:
-	Registry() {
-		Logger::Log("Registry constructor called!");
+	void ReleaseRetiredShares() {
+		for (PageShare* share : retiredShares) {
+			ReleaseShare(share);
+		}
+		retiredShares.clear();
 	}
 
-	~Registry() {
-		Logger::Log("Registry destructor called!");
+	// Drops a page of this pool, destroying its components if the pool owns it
+	void ReleasePage(int pageIndex) {
+		PageRef& pageRef = pages[pageIndex];
+		if (PageShare* share = pageRef.share.load(std::memory_order_relaxed)) {
+			numSharedPages.fetch_sub(1, std::memory_order_relaxed);
+			ReleaseShare(share);
+			return;
+		}
+		Page* page = pageRef.page.load(std::memory_order_relaxed);
+		if (PageShare* share = page->share.load(std::memory_order_relaxed)) {
+			FreezePage(page, share, pageIndex);
+		}
+		if constexpr (!std::is_trivially_destructible<T>::value) {
+			const int end = std::min(size, (pageIndex + 1) * POOL_PAGE_SIZE);
+			for (int index = pageIndex * POOL_PAGE_SIZE; index < end; index++) {
+				if (indexToEntityId[index] != -1) {
+					reinterpret_cast<T*>(page->bytes)[index % POOL_PAGE_SIZE].~T();
+				}
+			}
+		}
+		delete page;
 	}
 
-	void Update();
-	
-	// Entity management
-	Entity CreateEntity();
-	void KillEntity(Entity entity);
+	// Moves the component at one index into the empty slot at another and ends the lifetime of the source
+	void Relocate(int index, int emptyIndex) {
+		T* source = GetWritableSlot(index);
+		T* destination = GetWritableSlot(emptyIndex);
+		if constexpr (TriviallyRelocatable<T>::value) {
+			std::memcpy(static_cast<void*>(destination), static_cast<const void*>(source), sizeof(T));
+		}
+		else {
+			new (destination) T(std::move(*source));
+			source->~T();
+		}
+	}
 
-	// Component management
-	template <typename TComponent, typename ...TArgs> void AddComponent(Entity entity, TArgs&& ...args);
-	template <typename TComponent> void RemoveComponent(Entity entity);
-	template <typename TComponent> bool HasComponent(Entity entity) const;
-	template <typename TComponent> TComponent& GetComponent(Entity entity) const;
+	int GetIndex(int entityId) const {
+		const int page = entityId / POOL_SPARSE_PAGE_SIZE;
+		if (page >= static_cast<int>(sparsePages.size()) || !sparsePages[page]) {
+			return -1;
+		}
+		return sparsePages[page][entityId % POOL_SPARSE_PAGE_SIZE];
+	}
 
-	// System management
-	template <typename TSystem, typename ...TArgs> void AddSystem(TArgs&& ...args);
-	template <typename TSystem> void RemoveSystem();
-	template <typename TSystem> bool HasSystem() const;
-	template <typename TSystem> TSystem& GetSystem() const;
+	void SetIndex(int entityId, int index) {
+		const int page = entityId / POOL_SPARSE_PAGE_SIZE;
+		if (page >= static_cast<int>(sparsePages.size())) {
+			sparsePages.resize(page + 1);
+		}
+		if (!sparsePages[page]) {
+			sparsePages[page] = std::shared_ptr<int[]>(new int[POOL_SPARSE_PAGE_SIZE]);
+			std::fill(sparsePages[page].get(), sparsePages[page].get() + POOL_SPARSE_PAGE_SIZE, -1);
+		}
+		else if (sparsePages[page].use_count() > 1) {
+			std::shared_ptr<int[]> copy(new int[POOL_SPARSE_PAGE_SIZE]);
+			std::copy(sparsePages[page].get(), sparsePages[page].get() + POOL_SPARSE_PAGE_SIZE, copy.get());
+			sparsePages[page] = std::move(copy);
+		}
+		sparsePages[page][entityId % POOL_SPARSE_PAGE_SIZE] = index;
+	}
 
-	// Add and remove entities from their systems
-	void AddEntityToSystems(Entity entity);
-	void RemoveEntityFromSystems(Entity entity);
-};
+	// Uninitialized slot for an entity that doesnt have the component yet, the caller constructs the component in it
+	T* AddSlot(int entityId) {
+		// The slot is made writable before it is marked as used, copying a shared page only copies the used slots
+		int index = -1;
+		T* slot = nullptr;
+		if (!freeIndices.empty()) {
+			index = freeIndices.back();
+			freeIndices.pop_back();
+			slot = GetWritableSlot(index);
+			indexToEntityId.Mutable(index) = entityId;
+		}
+		else {
+			index = size;
+			if (index / POOL_PAGE_SIZE >= static_cast<int>(pages.size())) {
+				pages.emplace_back(new Page());
+			}
+			slot = GetWritableSlot(index);
+			size++;
+			indexToEntityId.push_back(entityId);
+		}
+
+		SetIndex(entityId, index);
+		return slot;
+	}
 
-template <typename TComponent, typename ...TArgs>
-void Registry::AddComponent(Entity entity, TArgs&& ...args) {
-	const int componentId = Component<TComponent>::GetID();
-	const int entityId = entity.GetId();
+public:
+	Pool(int capacity = 100) {
+		Reserve(capacity);
+	}
 
-	// Resize component pools if needed
-	if (componentPools.size() <= componentId) {
-		componentPools.resize(componentId + 1);
+	virtual ~Pool() {
+		Clear();
 	}
 
-	if (!componentPools[componentId]) {
-		std::shared_ptr<Pool<TComponent>> newPool = std::make_shared<Pool<TComponent>>();
-		componentPools[componentId] = newPool;
+	bool IsEmpty() const {
+		return size == static_cast<int>(freeIndices.size());
 	}
 
-	std::shared_ptr<Pool<TComponent>> componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
-	
-	if (componentPool->GetSize() <= entityId) {
-		componentPool->Resize(numEntities);
+	int GetSize() const override {
+		return size;
 	}
 
-	TComponent newComponent(std::forward<TArgs>(args)...);
+	// Allocates the pages up front, existing components stay where they are
+	void Reserve(int capacity) {
+		while (static_cast<int>(pages.size()) * POOL_PAGE_SIZE < capacity) {
+			pages.emplace_back(new Page());
+		}
+	}
 
-	componentPool->Set(entityId, newComponent);
+	void Clear() {
+		ReleaseRetiredShares();
+		for (int pageIndex = 0; pageIndex < static_cast<int>(pages.size()); pageIndex++) {
+			ReleasePage(pageIndex);
+		}
+		size = 0;
+		pages.clear();
+		indexToEntityId.clear();
+		sparsePages.clear();
+		freeIndices.clear();
+	}
 
-	entityComponentSignatures[entityId].set(componentId);
+	bool Has(int entityId) const {
+		return GetIndex(entityId) != -1;
+	}
 
-	Logger::Log("Component ID: " + std::to_string(componentId) + " was added to entity ID: " + std::to_string(entityId));
-}
+	void Set(int entityId, T object) {
+		const int index = GetIndex(entityId);
+		if (index != -1) {
+			// Replace the existing component
+			*GetWritableSlot(index) = std::move(object);
+			return;
+		}
 
-template <typename TComponent, typename ...TArgs>
-void Entity::AddComponent(TArgs&& ...args) {
-	registry->AddComponent<TComponent>(*this, std::forward<TArgs>(args)...);
-}
+		new (AddSlot(entityId)) T(std::move(object));
+	}
 
-template <typename TComponent>
-void Registry::RemoveComponent(Entity entity) {
-	const int componentId = Component<TComponent>::GetID();
-	const int entityId = entity.GetId();
+	void Remove(int entityId) {
+		const int index = GetIndex(entityId);
+		if (index == -1) {
+			return;
+		}
+
+		GetWritableSlot(index)->~T();
+		SetIndex(entityId, -1);
+
+		if (StableComponent<T>::value) {
+			// Leave a hole so no other component moves
+			indexToEntityId.Mutable(index) = -1;
+			freeIndices.push_back(index);
+			return;
+		}
+
+		// Move the last element into the hole to keep the data packed
+		const int indexOfLast = size - 1;
+		if (index != indexOfLast) {
+			const int entityIdOfLast = indexToEntityId[indexOfLast];
+			Relocate(indexOfLast, index);
+			indexToEntityId.Mutable(index) = entityIdOfLast;
+			SetIndex(entityIdOfLast, index);
+		}
+
+		indexToEntityId.pop_back();
+		size--;
+	}
 
-	// No need to physically remove the component from the pool
-	entityComponentSignatures[entityId].set(componentId, false);
+	void RemoveEntityFromPool(int entityId) override {
+		Remove(entityId);
+	}
 
-	Logger::Log("Component ID: " + std::to_string(componentId) + " was removed from entity ID: " + std::to_string(entityId));
-}
+	void RemapEntity(int entityId, int newEntityId) override {
+		const int index = GetIndex(entityId);
+		if (index == -1) {
+			return;
+		}
+		SetIndex(entityId, -1);
+		SetIndex(newEntityId, index);
+		indexToEntityId.Mutable(index) = newEntityId;
+	}
 
-template<typename TComponent>
-void Entity::RemoveComponent() {
-	registry->RemoveComponent<TComponent>(*this);
-}
+	// newEntityId must not have the component yet, trivially copyable types are copied with memcpy
+	void CopyComponent(int entityId, int newEntityId) override {
+		const ComponentTypeInfo& typeInfo = GetComponentTypeInfo<T>();
+		if (!typeInfo.isTriviallyCopyable && !typeInfo.copyConstruct) {
+			Logger::Err("Component type " + typeInfo.name + " cannot be copied.");
+			return;
+		}
+
+		// The source is looked up after the slot is added, adding it can copy the page the source is on
+		T* slot = AddSlot(newEntityId);
+		typeInfo.CopyConstruct(slot, GetSlot(GetIndex(entityId)));
+	}
 
-template <typename TComponent>
-bool Registry::HasComponent(Entity entity) const {
-	const int componentId = Component<TComponent>::GetID();
-	const int entityId = entity.GetId();
+	std::shared_ptr<IPool> Fork() override {
+		if constexpr (std::is_copy_constructible<T>::value) {
+			ReleaseRetiredShares();
+			std::shared_ptr<Pool<T>> fork = std::make_shared<Pool<T>>(0);
+			fork->pages.reserve(pages.size());
+			for (PageRef& pageRef : pages) {
+				// Borrowed pages are lent on by their share, owned pages get one the first time they are lent
+				PageShare* share = pageRef.share.load(std::memory_order_relaxed);
+				if (!share) {
+					Page* page = pageRef.page.load(std::memory_order_relaxed);
+					share = page->share.load(std::memory_order_relaxed);
+					if (!share) {
+						share = new PageShare(page);
+						page->share.store(share, std::memory_order_release);
+						numSharedPages.fetch_add(1, std::memory_order_release);
+					}
+				}
+				share->refCount.fetch_add(1, std::memory_order_relaxed);
+				fork->pages.emplace_back(share->page, share);
+			}
+			fork->numSharedPages.store(static_cast<int>(fork->pages.size()), std::memory_order_release);
+			fork->size = size;
+			fork->indexToEntityId = indexToEntityId;
+			fork->sparsePages = sparsePages;
+			fork->freeIndices = freeIndices;
+			return fork;
+		}
+		else {
+			Logger::Err("Component type " + GetComponentTypeInfo<T>().name + " cannot be copied.");
+			return nullptr;
+		}
+	}
 
-	return entityComponentSignatures[entityId].test(componentId);
-}
+	void Compact() override {
+		ReleaseRetiredShares();
+
+		// Holes at the end only need to be dropped, they are the largest free indices
+		std::sort(freeIndices.begin(), freeIndices.end());
+		while (size > 0 && indexToEntityId[size - 1] == -1) {
+			indexToEntityId.pop_back();
+			freeIndices.pop_back();
+			size--;
+		}
+
+		// Release the pages past the last component and the sparse pages without entities
+		const size_t numUsedPages = (size + POOL_PAGE_SIZE - 1) / POOL_PAGE_SIZE;
+		while (pages.size() > numUsedPages) {
+			ReleasePage(static_cast<int>(pages.size()) - 1);
+			pages.pop_back();
+		}
+		indexToEntityId.shrink_to_fit();
+		for (auto& sparsePage : sparsePages) {
+			if (sparsePage && std::all_of(sparsePage.get(), sparsePage.get() + POOL_SPARSE_PAGE_SIZE, [](int index) { return index == -1; })) {
+				sparsePage.reset();
+			}
+		}
+		while (!sparsePages.empty() && !sparsePages.back()) {
+			sparsePages.pop_back();
+		}
+	}
+
+	// Mutable access counts as a write, see GetWritableSlot
+	T& Get(int entityId) {
+		return *GetWritableSlot(GetIndex(entityId));
+	}
+
+	const T& Get(int entityId) const {
+		return *GetSlot(GetIndex(entityId));
+	}
+
+	int GetEntityId(int index) const override {
+		return indexToEntityId[index];
+	}
+
+	T& operator [](int index) {
+		return *GetWritableSlot(index);
+	}
+};
+
+// SharedPool
+// Deduplicated values of a shared component type, many entities reference the same value
+// Every value keeps the packed list of the entities that use it, so they can be iterated together
+// Values stay in the pool when their last entity leaves and are reused when set again
+class ISharedPool {
+private:
+	// Vector index is the value index
+	std::vector<std::vector<EntityHandle>> valueEntities;
+
+	// Value index and index inside the value list of every entity, -1 if the entity doesnt use the component
+	// Vector index is the entity id
+	std::vector<int> entityValueIndices;
+	std::vector<int> entityPositions;
+
+protected:
+	int AddValueSlot() {
+		valueEntities.emplace_back();
+		return static_cast<int>(valueEntities.size()) - 1;
+	}
+
+public:
+	virtual ~ISharedPool() = default;
+
+	// Copy of the values and of the entities that use them
+	virtual std::unique_ptr<ISharedPool> Clone() const = 0;
+
+	int GetNumValues() const {
+		return static_cast<int>(valueEntities.size());
+	}
+
+	// Returns -1 if the entity doesnt use the component
+	int GetValueIndex(int entityId) const {
+		return entityId < static_cast<int>(entityValueIndices.size()) ? entityValueIndices[entityId] : -1;
+	}
+
+	const std::vector<EntityHandle>& GetEntities(int valueIndex) const {
+		return valueEntities[valueIndex];
+	}
+
+	// Moves the entity to the list of another value
+	void SetValueIndex(EntityHandle entity, int valueIndex);
+	void RemoveEntityFromPool(int entityId);
+
+	// Replaces the handle of an entity renumbered by Registry::Compact, keeping its value
+	void RemapEntity(int entityId, EntityHandle newEntity);
+};
+
+template <typename T>
+class SharedPool : public ISharedPool {
+private:
+	// Vector index is the value index
+	std::vector<T> values;
+
+public:
+	// Index of the value equal to the given one, added if there is none yet
+	// Values are compared one by one, shared components are meant for a handful of distinct values
+	int FindOrAddValue(const T& value) {
+		for (int valueIndex = 0; valueIndex < static_cast<int>(values.size()); valueIndex++) {
+			if (values[valueIndex] == value) {
+				return valueIndex;
+			}
+		}
+		values.push_back(value);
+		return AddValueSlot();
+	}
+
+	const T& GetValue(int valueIndex) const {
+		return values[valueIndex];
+	}
+
+	std::unique_ptr<ISharedPool> Clone() const override {
+		return std::make_unique<SharedPool<T>>(*this);
+	}
+};
+
+// Number of entities Registry::Compact renumbers per call if no budget is given
+const int DEFAULT_COMPACT_BUDGET = 256;
+
+// Storage backend
+// Sparse set pools are the default, the archetype backend groups
+// entities with the same signature together in chunks
+enum class StorageBackend {
+	SparseSet,
+	Archetype
+};
+
+// Size in bytes of one archetype chunk
+const int ARCHETYPE_CHUNK_SIZE = 16 * 1024;
+
+// Chunk
+// Fixed size block of memory that stores the components of an archetype
+// as parallel arrays, one column per component type
+struct ArchetypeChunk {
+	unsigned char* memory = nullptr;
+	std::vector<int> entityIds;
+	int count = 0;
+};
+
+// Archetype
+// All entities that have exactly the same signature
+class Archetype {
+private:
+	Signature signature;
+
+	// Columns are ordered by component id
+	std::vector<int> componentIds;
+	std::vector<const ComponentTypeInfo*> columnInfos;
+	std::vector<size_t> columnOffsets;
+
+	// Component id to column index, -1 if the archetype doesnt have the component
+	std::vector<int> componentIdToColumn;
+
+	int chunkCapacity = 0;
+	size_t chunkBytes = 0;
+	std::vector<ArchetypeChunk> chunks;
+
+public:
+	Archetype(const Signature& signature);
+	~Archetype();
+
+	Archetype(const Archetype&) = delete;
+	Archetype& operator =(const Archetype&) = delete;
+
+	const Signature& GetSignature() const {
+		return signature;
+	}
+
+	const std::vector<int>& GetComponentIds() const {
+		return componentIds;
+	}
+
+	int GetNumChunks() const {
+		return static_cast<int>(chunks.size());
+	}
+
+	ArchetypeChunk& GetChunk(int chunkIndex) {
+		return chunks[chunkIndex];
+	}
+
+	bool HasComponent(int componentId) const {
+		return componentIdToColumn[componentId] != -1;
+	}
+
+	// Start of the column of a component inside a chunk
+	void* GetColumn(int componentId, int chunkIndex) const {
+		const int column = componentIdToColumn[componentId];
+		return chunks[chunkIndex].memory + columnOffsets[column];
+	}
+
+	void* GetComponent(int componentId, int chunkIndex, int row) const {
+		const int column = componentIdToColumn[componentId];
+		return chunks[chunkIndex].memory + columnOffsets[column] + row * columnInfos[column]->size;
+	}
+
+	// Reserves an uninitialized row at the end of the archetype
+	void AllocateRow(int entityId, int& chunkIndex, int& row);
+
+	// Removes a row by moving the last row of the archetype into it
+	// Returns the id of the entity that was moved into the row or -1
+	int RemoveRow(int chunkIndex, int row, bool destroyComponents);
+};
+
+// Where the components of an entity live in the archetype storage
+struct EntityLocation {
+	Archetype* archetype = nullptr;
+	int chunkIndex = -1;
+	int row = -1;
+};
+
+// ArchetypeStorage
+// Alternative to the component pools, components of entities with the
+// same signature are stored side by side so systems can stream them
+class ArchetypeStorage {
+private:
+	std::unordered_map<Signature, std::unique_ptr<Archetype>> archetypes;
+
+	// Vector index is the entity id
+	std::vector<EntityLocation> entityLocations;
+
+	Archetype* GetOrCreateArchetype(const Signature& signature);
+
+	// Moves all components the target archetype has, destroys the others
+	void MoveEntity(int entityId, Archetype* target);
+
+public:
+	ArchetypeStorage() = default;
+	~ArchetypeStorage() = default;
+
+	// Moves the entity to the archetype of the new signature
+	// Returns the uninitialized memory for the added component
+	void* AddComponent(int entityId, int componentId, const Signature& newSignature);
+
+	// Places an entity without components directly in the archetype of the signature
+	// The component memory is left uninitialized for the caller to construct
+	void AddEntity(int entityId, const Signature& signature);
+	void RemoveComponent(int entityId, int componentId, const Signature& newSignature);
+	void RemoveEntity(int entityId);
+
+	// Gives the row of an entity to another entity id, the components stay in place
+	void RemapEntity(int entityId, int newEntityId);
+
+	// Drops archetypes whose entities all left, chunks are already freed when they empty
+	void ReleaseEmptyArchetypes();
+
+	void* GetComponent(int entityId, int componentId) const {
+		const EntityLocation& location = entityLocations[entityId];
+		return location.archetype->GetComponent(componentId, location.chunkIndex, location.row);
+	}
+
+	// Calls func(count, entityIds, TComponents* ...columns) for every chunk of every archetype matching the signature
+	template <typename ...TComponents, typename TFunc> void ForEachChunk(const Signature& signature, TFunc&& func);
+
+	template <typename TFunc> void ForEachArchetype(TFunc&& func) {
+		for (auto& pair : archetypes) {
+			func(*pair.second);
+		}
+	}
+};
+
+template <typename ...TComponents, typename TFunc>
+void ArchetypeStorage::ForEachChunk(const Signature& signature, TFunc&& func) {
+	for (auto& pair : archetypes) {
+		Archetype* archetype = pair.second.get();
+		if (!archetype->GetSignature().Contains(signature)) {
+			continue;
+		}
+		for (int chunkIndex = 0; chunkIndex < archetype->GetNumChunks(); chunkIndex++) {
+			const ArchetypeChunk& chunk = archetype->GetChunk(chunkIndex);
+			func(
+				chunk.count,
+				chunk.entityIds.data(),
+				static_cast<TComponents*>(archetype->GetColumn(Component<TComponents>::GetID(), chunkIndex))...
+			);
+		}
+	}
+}
+
+// Exclude
+// Component types an entity must not have to be part of a view
+// Example: registry->View<TransformComponent>(Exclude<RigidBodyComponent>())
+template <typename ...TComponents>
+struct Exclude {};
+
+// Tick of the last addition and the last change of a component
+struct ComponentTicks {
+	uint32_t added = 0;
+	uint32_t changed = 0;
+};
+
+// Changed / Added
+// Tick filters of a view, keep the entities where one of the component types was changed (or added) after sinceTick
+// Changes are only seen if the writer calls MarkChanged, adding or replacing a component counts as a change
+// Example:
+//   const uint32_t sinceTick = lastTick;
+//   lastTick = registry->AdvanceTick();
+//   registry->View<TransformComponent>(Changed<TransformComponent>(sinceTick))
+template <typename ...TComponents>
+struct Changed {
+	uint32_t sinceTick;
+
+	explicit Changed(uint32_t sinceTick) : sinceTick(sinceTick) {}
+
+	static uint32_t GetTick(const ComponentTicks& ticks) {
+		return ticks.changed;
+	}
+};
+
+template <typename ...TComponents>
+struct Added {
+	uint32_t sinceTick;
+
+	explicit Added(uint32_t sinceTick) : sinceTick(sinceTick) {}
+
+	static uint32_t GetTick(const ComponentTicks& ticks) {
+		return ticks.added;
+	}
+};
+
+template <typename T>
+struct IsTickFilter : std::false_type {};
+
+template <typename ...TComponents>
+struct IsTickFilter<Changed<TComponents...>> : std::true_type {};
+
+template <typename ...TComponents>
+struct IsTickFilter<Added<TComponents...>> : std::true_type {};
+
+// Key of a cached view, views with different excluded types are cached separately
+template <typename TIncluded, typename TExcluded>
+struct ViewKey {};
+
+template <typename ...TComponents>
+struct ViewEntry {
+	EntityHandle entity;
+	std::tuple<TComponents*...> components;
+};
+
+// Cached entities of a view, rebuilt when one of its component types has a structural change
+class IViewCache {
+public:
+	virtual ~IViewCache() = default;
+};
+
+template <typename ...TComponents>
+class ViewCache : public IViewCache {
+public:
+	bool isBuilt = false;
+
+	// Versions of the included and excluded component types the entries were built with
+	std::vector<uint32_t> componentVersions;
+
+	// Page version of the included pools the entries were built with, see IPool::GetPageVersion
+	uint32_t pageVersion = 0;
+
+	std::vector<ViewEntry<TComponents...>> entries;
+};
+
+// ComponentView
+// Entities that have all of the components, with references straight into the component storage
+// Stays valid until the next structural change of one of its component types
+// Disabled entities stay in the cached entries and are skipped while iterating, so enabling and disabling doesnt rebuild views
+template <typename ...TComponents>
+class ComponentView {
+private:
+	class Registry* registry;
+	const std::vector<ViewEntry<TComponents...>>* entries;
+
+	// Entries of a tick filtered view, owned by the view and its copies instead of the view cache
+	std::shared_ptr<const std::vector<ViewEntry<TComponents...>>> ownedEntries;
+
+	// Page version of the pools the entries were built with
+	uint32_t pageVersion;
+
+public:
+	class Iterator {
+	private:
+		class Registry* registry;
+		const ViewEntry<TComponents...>* entry;
+		const ViewEntry<TComponents...>* last;
+		bool useCachedPointers;
+		bool skipsDisabled;
+
+		void SkipDisabled();
+
+	public:
+		Iterator(class Registry* registry, const ViewEntry<TComponents...>* entry, const ViewEntry<TComponents...>* last, bool useCachedPointers, bool skipsDisabled) :
+			registry(registry), entry(entry), last(last), useCachedPointers(useCachedPointers), skipsDisabled(skipsDisabled) {
+			SkipDisabled();
+		}
+
+		std::tuple<Entity, TComponents&...> operator *() const;
+
+		Iterator& operator ++() {
+			entry++;
+			SkipDisabled();
+			return *this;
+		}
+
+		bool operator !=(const Iterator& other) const {
+			return entry != other.entry;
+		}
+	};
+
+	ComponentView(class Registry* registry, const std::vector<ViewEntry<TComponents...>>* entries, uint32_t pageVersion) : registry(registry), entries(entries), pageVersion(pageVersion) {}
+	ComponentView(class Registry* registry, std::shared_ptr<const std::vector<ViewEntry<TComponents...>>> ownedEntries, uint32_t pageVersion) :
+		registry(registry), entries(ownedEntries.get()), ownedEntries(std::move(ownedEntries)), pageVersion(pageVersion) {}
+
+	Iterator begin() const;
+	Iterator end() const;
+
+	// Counts the enabled entries while any entity of the registry is disabled
+	int GetSize() const;
+	bool IsEmpty() const;
+
+	// Calls func(entity, TComponents& ...components) for every entity of the view
+	template <typename TFunc> void Each(TFunc&& func) const;
+
+	// Same as Each but split across the job system of the registry, func must only touch the given entity
+	template <typename TFunc> void ParallelEach(TFunc&& func, int grainSize = DEFAULT_GRAIN_SIZE) const;
+};
+
+// ComponentChanges
+// Net changes of one component type since the previous Update, passed to the observers of the type
+// An entity that got the component and lost it again in the same frame is not reported
+// Removed entities keep the handle they had, the killed ones are no longer alive
+struct ComponentChanges {
+	std::vector<Entity> added;
+	std::vector<Entity> removed;
+	std::vector<Entity> replaced;
+
+	bool IsEmpty() const {
+		return added.empty() && removed.empty() && replaced.empty();
+	}
+};
+
+typedef std::function<void(const ComponentChanges& changes)> ComponentObserver;
+
+// New handles of the entities renumbered by Registry::Compact, key is the value of the old handle
+typedef std::unordered_map<uint32_t, EntityHandle> HandleRemap;
+
+typedef std::function<void(const HandleRemap& remappedHandles)> RemapObserver;
+
+// Structural change of an entity recorded by the registry
+enum class EntityCommandType {
+	Create,
+	AddComponent,
+	RemoveComponent,
+	Kill
+};
+
+struct EntityCommand {
+	EntityCommandType type;
+	EntityHandle entity;
+	int componentId = -1;
+};
+
+// CommandBuffer
+// Structural changes recorded by one thread while systems run in parallel, played back at the start of Registry::Update
+// Every thread records into its own buffer without locks, see Registry::GetCommandBuffer
+// Playback sorts the commands by sort key, so the result doesnt depend on which worker recorded them
+// Commands with the same sort key are ordered by the scheduled system, the phase of the system, the parallel for chunk
+// and the order inside the chunk that recorded them
+class alignas(CACHE_LINE_SIZE) CommandBuffer {
+private:
+	// Where the commands are recorded, set by Registry::RunScheduledSystems and Registry::ParallelFor
+	struct Origin {
+		// Position of the system in the systems scheduled since the last Update, 0 outside of scheduled systems
+		int systemOrder = 0;
+		// Bumped when a parallel for of the system starts and again when it finishes,
+		// so commands recorded after the loop come after the ones recorded inside it
+		int phase = 0;
+		// First index of the parallel for chunk plus one, 0 outside of parallel for
+		int jobIndex = 0;
+		// Number of commands recorded before by the same job
+		int sequence = 0;
+
+		bool operator <(const Origin& other) const {
+			return std::tie(systemOrder, phase, jobIndex, sequence) < std::tie(other.systemOrder, other.phase, other.jobIndex, other.sequence);
+		}
+	};
+
+	struct Command {
+		// Instantiations have their own range of sort keys, after the entity ids of the other commands
+		bool isInstantiation;
+		int sortKey;
+		Origin origin;
+		std::function<void(class Registry& registry)> apply;
+	};
+	std::vector<Command> commands;
+	Origin origin;
+
+	void Record(bool isInstantiation, int sortKey, std::function<void(class Registry& registry)> apply) {
+		commands.push_back({ isInstantiation, sortKey, origin, std::move(apply) });
+		origin.sequence++;
+	}
+
+	friend class Registry;
+
+public:
+	bool IsEmpty() const {
+		return commands.empty();
+	}
+
+	// The entity id is the sort key, entities that are no longer alive at playback are skipped
+	void KillEntity(Entity entity);
+	template <typename TComponent, typename ...TArgs> void AddComponent(Entity entity, TArgs&& ...args);
+	template <typename TComponent> void RemoveComponent(Entity entity);
+	void SetEntityEnabled(Entity entity, bool isEnabled);
+
+	// The prefab must stay alive until the next Update
+	// Instantiations are played back after the commands for existing entities, ordered by their own sort key
+	void Instantiate(const class Prefab& prefab, int count, int sortKey);
+};
+
+// Registry
+// Manages creation and destruction of entities,
+// adding systems and components
+class Registry {
+private:
+	int numEntities = 0;
+
+	StorageBackend storageBackend;
+
+	// Only used by the archetype backend, component pools stay empty
+	std::unique_ptr<ArchetypeStorage> archetypeStorage;
+
+	// Vector of component pools. Each pool contains all instances of a specific component type
+	// Vector index is the component id
+	// Pools are sparse sets, only entities that have the component take a slot
+	std::vector<std::shared_ptr<IPool>> componentPools;
+
+	// Vector of component signatures used by entities
+	// Vector index is the entity id
+	CopyOnWriteArray<Signature> entityComponentSignatures;
+
+	std::unordered_map<std::type_index, std::shared_ptr<System>> systems;
+
+	// Contiguous copies of the system signatures so entity signatures can be matched against all of them in bulk
+	std::vector<System*> systemList;
+	std::vector<Signature> systemSignatures;
+
+	void RefreshSystemList();
+
+	// Adds the entities the systems already know about to a system added after them
+	void AddExistingEntities(System& system);
+
+	// Structural changes recorded during the frame, applied in a batch by Update
+	std::vector<EntityCommand> entityCommands;
+
+	// Signature the systems currently know each entity by, only updated by Update
+	// Vector index is the entity id
+	CopyOnWriteArray<Signature> entitySystemSignatures;
+
+	// Queue of free entity ids that were previously removed
+	std::deque<int> freeIds;
+
+	// One bit per entity id, set for disabled entities
+	std::vector<uint64_t> disabledEntityBits;
+	int numDisabledEntities = 0;
+
+	// Tags name exactly one entity
+	std::unordered_map<std::string, EntityHandle> entityPerTag;
+	std::unordered_map<int, std::string> tagPerEntity;
+
+	// Groups hold any number of entities, packed so they can be iterated without copies
+	// Vector index is the group id
+	std::unordered_map<std::string, int> groupIds;
+	std::vector<std::vector<EntityHandle>> groupEntities;
+
+	// Group id and index inside the group of every entity, -1 if the entity has no group
+	// Vector index is the entity id
+	std::vector<int> entityGroupIds;
+	std::vector<int> entityGroupIndices;
+
+	// Pools of the shared component types, created on first use
+	// Vector index is the component id
+	std::vector<std::unique_ptr<ISharedPool>> sharedComponentPools;
+	Signature sharedComponentTypes;
+
+	template <typename TComponent> SharedPool<TComponent>* GetSharedPool() const;
+	template <typename TComponent> SharedPool<TComponent>* GetOrCreateSharedPool();
+
+	// Shared component types are part of the entity signatures but are kept out of the archetypes
+	Signature WithoutSharedComponents(Signature signature) const;
+
+	// Set when entities or components were removed since the last finished Compact
+	bool needsCompaction = false;
+
+	// New handles of the entities renumbered since the current compaction started
+	HandleRemap remappedHandles;
+
+	// Gives every piece of state of an entity to a lower free id
+	void RenumberEntity(int entityId, int newEntityId);
+
+	// Invalidates every handle to the entity id
+	void IncrementGeneration(int entityId);
+
+	// Current generation of every entity id, bumped when the entity is killed
+	// Vector index is the entity id
+	CopyOnWriteArray<uint32_t> entityGenerations;
+
+	// Structural version of every component type, bumped when components of the type are added, removed or moved
+	// Vector index is the component id
+	std::vector<uint32_t> componentVersions;
+
+	// Workers used by parallel iteration, not owned, iteration is serial without one
+	JobSystem* jobSystem = nullptr;
+
+	// One command buffer per thread of the job system, vector index is the thread index
+	std::vector<std::unique_ptr<CommandBuffer>> commandBuffers;
+
+	// Merges the command buffers of all threads in sort key order and applies them
+	void PlaybackCommandBuffers();
+
+	// Cached view results, key is the ViewKey type of the view
+	// Systems running at the same time may build their views concurrently
+	std::unordered_map<std::type_index, std::unique_ptr<IViewCache>> viewCaches;
+	std::mutex viewCacheMutex;
+
+	// System updates queued for the next RunScheduledSystems, in the order they were scheduled
+	struct ScheduledSystem {
+		System* system;
+		std::function<void()> update;
+	};
+	std::vector<ScheduledSystem> scheduledSystems;
+
+	// Systems scheduled since the last Update, orders the commands they record
+	int numScheduledSystemsRun = 0;
+
+	// Tick groups, run in the order they were added by RunTickGroups
+	struct TickGroup {
+		// Fixed time step in seconds, 0 for once per frame with the frame time
+		double stepTime;
+		int maxTicksPerFrame;
+		// Frame time not yet consumed by ticks
+		double accumulator = 0.0;
+		// Schedule the update of one system with the delta time of the tick
+		std::vector<std::function<void(double)>> scheduleUpdates;
+	};
+	std::vector<TickGroup> tickGroups;
+
+	// Added and changed ticks of every component
+	// Outer index is the component id, inner index is the entity id
+	std::vector<std::vector<ComponentTicks>> componentTicks;
+
+	// Stamped into the ticks of added and changed components, only moves forward with AdvanceTick
+	std::atomic<uint32_t> currentTick{ 1 };
+
+	// Observers of every component type and the changes collected for them until the next Update
+	// Vector index is the component id
+	struct ObserverEntry {
+		int observerId;
+		ComponentObserver observer;
+	};
+	std::vector<std::vector<ObserverEntry>> componentObservers;
+	std::vector<std::pair<int, RemapObserver>> remapObservers;
+	std::vector<ComponentChanges> pendingComponentChanges;
+	Signature observedComponents;
+	int nextObserverId = 0;
+
+	// Set when a replacement was recorded, they refer to entity ids that Compact could change
+	bool hasPendingReplacements = false;
+
+	// Replacements are recorded when they happen, additions and removals are derived from the signatures in Update
+	void RecordReplacedComponent(int componentId, EntityHandle entity);
+	void RecordObservedChanges(Entity entity, const Signature& oldSignature, const Signature& newSignature, const Signature& addedSignature);
+	void NotifyObservers();
+
+	// Stamps the current tick as the change tick, and as the added tick if the component is new
+	void StampComponentTicks(int componentId, int entityId, bool isAdded);
+	ComponentTicks GetComponentTicks(int componentId, int entityId) const;
+
+	template <template <typename...> class TFilter, typename ...TFiltered>
+	bool MatchesTickFilter(const TFilter<TFiltered...>& filter, int entityId) const;
+
+	void IncrementComponentVersions(const Signature& signature);
+
+	template <typename TComponent> Pool<TComponent>* GetComponentPool() const;
+	template <typename TComponent> Pool<TComponent>* GetOrCreateComponentPool();
+
+	// Adds or replaces a component without logging, shared by the single and bulk paths
+	template <typename TComponent, typename ...TArgs> void EmplaceComponent(EntityHandle entity, TArgs&& ...args);
+
+	// Adds the default cold part of a split component type to the entities that dont have it yet
+	template <typename TComponent> void AddMissingColdComponents(const Entity* entities, size_t count);
+
+	// Prepares the storage of a component type and copies a prefab value to entities whose signature is already set
+	template <typename TComponent> void RegisterComponentStorage();
+	template <typename TComponent> void CopyPrefabComponent(const std::vector<Entity>& entities, const TComponent& value);
+
+	template <typename TComponent> friend class PrefabComponent;
+
+	// Sum of the page versions of the pools of the component types, see IPool::GetPageVersion
+	template <typename ...TComponents> uint32_t GetPageVersion() const;
+
+	// False while one of the pools shares pages with a forked registry or replaced a page since the view was built
+	// Views then look every component up through the pool instead of using the cached pointers
+	template <typename ...TComponents> bool CanUseCachedPointers(uint32_t pageVersion) const;
+
+	template <typename ...TComponents> friend class ComponentView;
+
+public:
+	Registry(StorageBackend storageBackend = StorageBackend::SparseSet) : storageBackend(storageBackend) {
+		componentVersions.resize(MAX_COMPONENTS, 0);
+		componentTicks.resize(MAX_COMPONENTS);
+		componentObservers.resize(MAX_COMPONENTS);
+		pendingComponentChanges.resize(MAX_COMPONENTS);
+		commandBuffers.push_back(std::make_unique<CommandBuffer>());
+		sharedComponentPools.resize(MAX_COMPONENTS);
+		if (storageBackend == StorageBackend::Archetype) {
+			archetypeStorage = std::make_unique<ArchetypeStorage>();
+		}
+		Logger::Log("Registry constructor called!");
+	}
+
+	~Registry() {
+		Logger::Log("Registry destructor called!");
+	}
+
+	void Update();
+
+	StorageBackend GetStorageBackend() const {
+		return storageBackend;
+	}
+
+	// Parallel iteration
+	void SetJobSystem(JobSystem* jobSystem);
+
+	JobSystem* GetJobSystem() const {
+		return jobSystem;
+	}
+
+	// Command buffer of the calling thread, the only way to make structural changes from systems running on workers
+	// Threads that are not workers of the job system share one buffer
+	CommandBuffer& GetCommandBuffer() const;
+
+	// Calls func(begin, end) for ranges covering [0, count), in parallel when a job system is set
+	template <typename TFunc> void ParallelFor(int count, TFunc&& func, int grainSize = DEFAULT_GRAIN_SIZE) const;
+	
+	// Entity management
+	// Returns a null entity once all MAX_ENTITIES ids are in use
+	Entity CreateEntity();
+	void KillEntity(Entity entity);
+
+	// Tag management, tagging another entity with the same tag moves the tag to it
+	// Killed entities lose their tag and group in Update
+	void TagEntity(Entity entity, const std::string& tag);
+	bool EntityHasTag(Entity entity, const std::string& tag) const;
+	// Returns a null entity if no entity has the tag
+	Entity GetEntityByTag(const std::string& tag);
+	void RemoveEntityTag(Entity entity);
+
+	// Group management, an entity belongs to at most one group
+	void GroupEntity(Entity entity, const std::string& group);
+	bool EntityBelongsToGroup(Entity entity, const std::string& group) const;
+	// Valid until the next change of the group
+	EntitySpan GetEntitiesByGroup(const std::string& group);
+	void RemoveEntityGroup(Entity entity);
+
+	// Creates count entities at once, they are added to their systems in the next Update like single entities
+	// Returns fewer entities if there are not enough ids left, see CreateEntity
+	std::vector<Entity> CreateEntities(int count);
+
+	// Renumbers live entities into the lowest free ids, then releases the unused pages of the component pools
+	// and shrinks the per entity arrays to the ids in use, the generations keep every id so stale handles stay dead
+	// Renumbers at most budget entities per call, call it every frame until it returns true
+	// Renumbered entities get new handles, the remap observers get them at the end of every call that renumbered entities
+	// Only runs right after Update, while no structural changes are pending
+	bool Compact(int budget = DEFAULT_COMPACT_BUDGET);
+
+	// Current handle of an entity that the running compaction renumbered, the same handle if it wasn't
+	// The renumbered handles are forgotten once Compact returns true, remap stored handles with a remap observer
+	EntityHandle GetRemappedHandle(EntityHandle handle) const;
+
+	// A handle is alive as long as its generation matches the current generation of its id
+	bool IsAlive(EntityHandle handle) const {
+		const int entityId = handle.GetIndex();
+		return entityId < static_cast<int>(entityGenerations.size()) && entityGenerations[entityId] == handle.GetGeneration();
+	}
+
+	Entity GetEntity(EntityHandle handle);
+
+	// Disabling takes an entity out of views, chunk iteration and GetSystemEntities right away,
+	// without removing anything, enabling brings it back the same way
+	void SetEntityEnabled(Entity entity, bool isEnabled);
+
+	bool IsEntityEnabled(int entityId) const {
+		const size_t word = entityId / 64;
+		return word >= disabledEntityBits.size() || !((disabledEntityBits[word] >> (entityId % 64)) & 1);
+	}
+
+	// Creates an entity with copies of all the components of another one, tags and groups are not copied
+	// Trivially copyable components are copied with memcpy
+	// Returns a null entity once all MAX_ENTITIES ids are in use
+	Entity CloneEntity(Entity entity);
+
+	// Creates count entities with copies of the prefab components
+	// Signatures are set once per entity and the whole batch joins its systems in the next Update
+	// Returns fewer entities if there are not enough ids left, see CreateEntity
+	std::vector<Entity> Instantiate(const class Prefab& prefab, int count = 1);
+
+	// Creates a registry with the same entities, components, tags and groups, to simulate ahead and throw away
+	// Component pages and entity signatures are shared copy on write, nothing is copied until one of the registries writes
+	// This registry keeps its components in place, before it first writes to a shared page the fork gets a copy of it
+	// The fork moves a component to its own copy of the page the first time it writes to it
+	// Mutable access counts as a write, reading with the const GetComponent or ReadComponent and building views copy nothing
+	// While a page is shared, views look every component up again instead of using the cached pointers
+	// This registry must not write components while a fork is updated on another thread
+	// The fork has no systems, observers, tick groups or job system, systems added to it get the entities that match
+	// Change ticks start over in the fork, components only count as changed once the fork changes them
+	// Only registries with the sparse set backend fork, right after Update while no structural changes are pending
+	// Returns null if the registry can't be forked
+	std::unique_ptr<Registry> Fork();
+
+	// Component management
+	template <typename TComponent, typename ...TArgs> void AddComponent(Entity entity, TArgs&& ...args);
+
+	// Adds the component generator(index) to every entity of the batch
+	// Example: registry->AddComponents<TransformComponent>(tiles, [](int i) { return TransformComponent(...); });
+	template <typename TComponent, typename TGenerator> void AddComponents(const std::vector<Entity>& entities, TGenerator&& generator);
+	template <typename TComponent> void RemoveComponent(Entity entity);
+	template <typename TComponent> bool HasComponent(Entity entity) const;
+	template <typename TComponent> TComponent& GetComponent(Entity entity);
+	template <typename TComponent> const TComponent& GetComponent(Entity entity) const;
+
+	// Cold part of a component type split with ColdComponent
+	template <typename TComponent> typename ColdComponent<TComponent>::Type& GetColdComponent(Entity entity);
+	template <typename TComponent> const typename ColdComponent<TComponent>::Type& GetColdComponent(Entity entity) const;
+
+	// Shared components
+	// Entities reference one deduplicated value instead of owning a copy, TComponent needs operator ==
+	// A type is either always used as a shared component or never, shared types count for the signatures of
+	// systems, but are read with GetSharedComponent instead of GetComponent and can't be part of views
+	template <typename TComponent> void AddSharedComponent(Entity entity, const TComponent& value);
+	template <typename TComponent> void AddSharedComponents(const std::vector<Entity>& entities, const TComponent& value);
+	template <typename TComponent> void RemoveSharedComponent(Entity entity);
+	template <typename TComponent> const TComponent& GetSharedComponent(Entity entity) const;
+
+	// Entities with the same index share the same value, -1 if the entity doesnt have the component
+	template <typename TComponent> int GetSharedValueIndex(Entity entity) const;
+
+	// Calls func(value, entities) for every distinct value that has entities, entities is an EntitySpan
+	template <typename TComponent, typename TFunc> void ForEachSharedValue(TFunc&& func);
+
+	// Enabled entities that have all of TComponents and none of TExcluded
+	// Example: registry->View<TransformComponent, RigidBodyComponent>(Exclude<BoxColliderComponent>())
+	template <typename ...TComponents, typename ...TExcluded> ComponentView<TComponents...> View(Exclude<TExcluded...> exclude);
+	template <typename ...TComponents> ComponentView<TComponents...> View();
+
+	// Entities of the view that pass a Changed or Added tick filter
+	// Example: registry->View<TransformComponent, SpriteComponent>(Changed<TransformComponent>(sinceTick))
+	template <typename ...TComponents, typename TFilter, typename ...TExcluded>
+	std::enable_if_t<IsTickFilter<TFilter>::value, ComponentView<TComponents...>> View(TFilter filter, Exclude<TExcluded...> exclude = Exclude<TExcluded...>());
+
+	// Change detection
+	// Writers mark the components they modify, readers keep the tick returned by AdvanceTick and filter views with it
+	template <typename TComponent> void MarkChanged(int entityId);
+
+	// True if the entity has the component and it was changed after sinceTick
+	template <typename TComponent> bool HasChanged(int entityId, uint32_t sinceTick) const;
+
+	uint32_t GetCurrentTick() const {
+		return currentTick.load(std::memory_order_relaxed);
+	}
+
+	// Returns the current tick and moves on to the next one, changes made afterwards are newer than the returned tick
+	uint32_t AdvanceTick() {
+		return currentTick.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Observers
+	// observer(changes) is called once per Update with the entities that got, lost or replaced the component since the previous one
+	// Runs at the end of Update, after the systems know about the changes, observers must not add or remove observers
+	// Example: registry->AddObserver<BoxColliderComponent>([&](const ComponentChanges& changes) { grid.Update(changes); });
+	template <typename TComponent> int AddObserver(ComponentObserver observer);
+
+	// observer(remappedHandles) is called at the end of every Compact call that renumbered entities,
+	// with the handles renumbered since the compaction started, components that store handles remap them right away
+	// Example: registry->AddRemapObserver([&](const HandleRemap& remappedHandles) { system.RemapTargets(remappedHandles); });
+	int AddRemapObserver(RemapObserver observer);
+	void RemoveObserver(int observerId);
+
+	// Calls func(count, TComponents* ...components) for contiguous runs of enabled entities that have all the components
+	// The archetype backend passes whole chunk columns, the sparse set backend passes one entity at a time
+	// func may also take the entity ids of the run as second parameter: func(count, const int* entityIds, TComponents* ...components)
+	template <typename ...TComponents, typename TFunc> void ForEachChunk(TFunc&& func);
+
+	// System management
+	template <typename TSystem, typename ...TArgs> void AddSystem(TArgs&& ...args);
+	template <typename TSystem> void RemoveSystem();
+	template <typename TSystem> bool HasSystem() const;
+	template <typename TSystem> TSystem& GetSystem() const;
+
+	// Adds and removes the entity only from the systems whose signature match flips
+	void UpdateEntitySystems(Entity entity, const Signature& oldSignature, const Signature& newSignature);
+
+	// Queues func(system) to run in the next RunScheduledSystems
+	template <typename TSystem, typename TFunc> void ScheduleSystem(TFunc&& func);
+
+	// Runs the queued system updates and returns when all of them are done
+	// A system waits for every system scheduled before it that it conflicts with, the rest run at the same time on the job system
+	void RunScheduledSystems();
+
+	// Adds a group of systems that tick at a fixed rate, 0 ticks once per frame with the frame time
+	// A frame runs at most maxTicksPerFrame ticks and drops the time it couldn't catch up on
+	// Returns the id of the tick group
+	int AddTickGroup(double ticksPerSecond, int maxTicksPerFrame = 4);
+
+	// Adds func(system, deltaTime) to every tick of the group, a system with its own rate gets a tick group of its own
+	template <typename TSystem, typename TFunc> void AddSystemToTickGroup(int tickGroupId, TFunc&& func);
+
+	// Runs the ticks deltaTime seconds are worth in every tick group, the systems of one tick are scheduled together
+	void RunTickGroups(double deltaTime);
+};
+
+// Prefab
+// Reusable template of component values with a precomputed signature
+// Example:
+//   Prefab bullet;
+//   bullet.AddComponent<TransformComponent>(glm::vec2(0, 0), glm::vec2(1, 1), 0.0);
+//   bullet.AddComponent<SpriteComponent>(bulletImage, 4, 4, 3);
+//   registry->Instantiate(bullet, 100);
+class IPrefabComponent {
+public:
+	virtual ~IPrefabComponent() = default;
+	virtual void RegisterStorage(Registry& registry) const = 0;
+	virtual void CopyTo(Registry& registry, const std::vector<Entity>& entities) const = 0;
+};
+
+template <typename TComponent>
+class PrefabComponent : public IPrefabComponent {
+public:
+	TComponent value;
+
+	template <typename ...TArgs>
+	PrefabComponent(TArgs&& ...args) : value(std::forward<TArgs>(args)...) {}
+
+	void RegisterStorage(Registry& registry) const override {
+		registry.RegisterComponentStorage<TComponent>();
+	}
+
+	void CopyTo(Registry& registry, const std::vector<Entity>& entities) const override {
+		registry.CopyPrefabComponent<TComponent>(entities, value);
+	}
+};
+
+class Prefab {
+private:
+	Signature signature;
+
+	// Vector index is the component id
+	std::vector<std::unique_ptr<IPrefabComponent>> components;
+
+public:
+	Prefab() = default;
+
+	template <typename TComponent, typename ...TArgs>
+	void AddComponent(TArgs&& ...args) {
+		const int componentId = Component<TComponent>::GetID();
+		if (componentId >= static_cast<int>(components.size())) {
+			components.resize(componentId + 1);
+		}
+		components[componentId] = std::make_unique<PrefabComponent<TComponent>>(std::forward<TArgs>(args)...);
+		signature.set(componentId);
+
+		if constexpr (HasColdComponent<TComponent>::value) {
+			if (!HasComponent<typename ColdComponent<TComponent>::Type>()) {
+				AddComponent<typename ColdComponent<TComponent>::Type>();
+			}
+		}
+	}
+
+	template <typename TComponent>
+	void RemoveComponent() {
+		const int componentId = Component<TComponent>::GetID();
+		if (componentId < static_cast<int>(components.size())) {
+			components[componentId].reset();
+		}
+		signature.set(componentId, false);
+	}
+
+	template <typename TComponent>
+	bool HasComponent() const {
+		return signature.test(Component<TComponent>::GetID());
+	}
+
+	// Allows tweaking the template values between instantiations
+	template <typename TComponent>
+	TComponent& GetComponent() {
+		return static_cast<PrefabComponent<TComponent>*>(components[Component<TComponent>::GetID()].get())->value;
+	}
+
+	const Signature& GetSignature() const {
+		return signature;
+	}
+
+	const std::vector<std::unique_ptr<IPrefabComponent>>& GetComponents() const {
+		return components;
+	}
+};
+
+template <typename TComponent>
+Pool<TComponent>* Registry::GetOrCreateComponentPool() {
+	const int componentId = Component<TComponent>::GetID();
+
+	// Resize component pools if needed
+	if (componentPools.size() <= componentId) {
+		componentPools.resize(componentId + 1);
+	}
+
+	if (!componentPools[componentId]) {
+		std::shared_ptr<Pool<TComponent>> newPool = std::make_shared<Pool<TComponent>>();
+		componentPools[componentId] = newPool;
+	}
+
+	return GetComponentPool<TComponent>();
+}
+
+template <typename TComponent, typename ...TArgs>
+void Registry::EmplaceComponent(EntityHandle entity, TArgs&& ...args) {
+	const int componentId = Component<TComponent>::GetID();
+	const int entityId = entity.GetIndex();
+
+	if (archetypeStorage) {
+		if (entityComponentSignatures[entityId].test(componentId)) {
+			// Replace the existing component in place
+			*static_cast<TComponent*>(archetypeStorage->GetComponent(entityId, componentId)) = TComponent(std::forward<TArgs>(args)...);
+			StampComponentTicks(componentId, entityId, false);
+			RecordReplacedComponent(componentId, entity);
+		}
+		else {
+			Signature newSignature = entityComponentSignatures[entityId];
+			newSignature.set(componentId);
+			void* memory = archetypeStorage->AddComponent(entityId, componentId, WithoutSharedComponents(newSignature));
+			new (memory) TComponent(std::forward<TArgs>(args)...);
+			entityComponentSignatures.Mutable(entityId) = newSignature;
+			StampComponentTicks(componentId, entityId, true);
+
+			// Every component of the entity moved to another archetype
+			IncrementComponentVersions(newSignature);
+			entityCommands.push_back({ EntityCommandType::AddComponent, entity, componentId });
+		}
+		return;
+	}
+
+	Pool<TComponent>* componentPool = GetOrCreateComponentPool<TComponent>();
+
+	TComponent newComponent(std::forward<TArgs>(args)...);
+
+	const bool isAdded = !entityComponentSignatures[entityId].test(componentId);
+	if (isAdded) {
+		componentVersions[componentId]++;
+		entityCommands.push_back({ EntityCommandType::AddComponent, entity, componentId });
+	}
+	else {
+		RecordReplacedComponent(componentId, entity);
+	}
+
+	componentPool->Set(entityId, std::move(newComponent));
+	StampComponentTicks(componentId, entityId, isAdded);
+
+	entityComponentSignatures.Mutable(entityId).set(componentId);
+}
+
+template <typename TComponent>
+void Registry::RegisterComponentStorage() {
+	// The archetype backend only needs the type info, registered with the component id
+	if (!archetypeStorage) {
+		GetOrCreateComponentPool<TComponent>();
+	}
+}
+
+template <typename TComponent>
+void Registry::CopyPrefabComponent(const std::vector<Entity>& entities, const TComponent& value) {
+	const int componentId = Component<TComponent>::GetID();
+
+	if (archetypeStorage) {
+		// The rows were already allocated in the archetype of the prefab signature
+		for (const auto& entity : entities) {
+			new (archetypeStorage->GetComponent(entity.GetId(), componentId)) TComponent(value);
+			StampComponentTicks(componentId, entity.GetId(), true);
+		}
+	}
+	else {
+		Pool<TComponent>* componentPool = GetComponentPool<TComponent>();
+		componentPool->Reserve(componentPool->GetSize() + static_cast<int>(entities.size()));
+		for (const auto& entity : entities) {
+			componentPool->Set(entity.GetId(), value);
+			StampComponentTicks(componentId, entity.GetId(), true);
+		}
+	}
+	componentVersions[componentId]++;
+}
+
+template <typename TComponent>
+void Registry::AddMissingColdComponents(const Entity* entities, size_t count) {
+	if constexpr (HasColdComponent<TComponent>::value) {
+		typedef typename ColdComponent<TComponent>::Type TCold;
+		const int coldComponentId = Component<TCold>::GetID();
+		for (size_t i = 0; i < count; i++) {
+			if (!entityComponentSignatures[entities[i].GetId()].test(coldComponentId)) {
+				EmplaceComponent<TCold>(entities[i].GetHandle());
+			}
+		}
+	}
+}
+
+template <typename TComponent, typename ...TArgs>
+void Registry::AddComponent(Entity entity, TArgs&& ...args) {
+	EmplaceComponent<TComponent>(entity.GetHandle(), std::forward<TArgs>(args)...);
+	AddMissingColdComponents<TComponent>(&entity, 1);
+
+	Logger::Log("Component ID: " + std::to_string(Component<TComponent>::GetID()) + " was added to entity ID: " + std::to_string(entity.GetId()));
+}
+
+template <typename TComponent, typename TGenerator>
+void Registry::AddComponents(const std::vector<Entity>& entities, TGenerator&& generator) {
+	const int componentId = Component<TComponent>::GetID();
+
+	if (archetypeStorage) {
+		for (size_t i = 0; i < entities.size(); i++) {
+			EmplaceComponent<TComponent>(entities[i].GetHandle(), generator(static_cast<int>(i)));
+		}
+	}
+	else {
+		// Reserve once and append the components contiguously to the pool
+		Pool<TComponent>* componentPool = GetOrCreateComponentPool<TComponent>();
+		componentPool->Reserve(componentPool->GetSize() + static_cast<int>(entities.size()));
+		entityCommands.reserve(entityCommands.size() + entities.size());
+
+		for (size_t i = 0; i < entities.size(); i++) {
+			const int entityId = entities[i].GetId();
+			const bool isAdded = !entityComponentSignatures[entityId].test(componentId);
+			if (isAdded) {
+				entityComponentSignatures.Mutable(entityId).set(componentId);
+				entityCommands.push_back({ EntityCommandType::AddComponent, entities[i].GetHandle(), componentId });
+			}
+			else {
+				RecordReplacedComponent(componentId, entities[i].GetHandle());
+			}
+			componentPool->Set(entityId, generator(static_cast<int>(i)));
+			StampComponentTicks(componentId, entityId, isAdded);
+		}
+		componentVersions[componentId]++;
+	}
+
+	AddMissingColdComponents<TComponent>(entities.data(), entities.size());
+
+	Logger::Log("Component ID: " + std::to_string(componentId) + " was added to " + std::to_string(entities.size()) + " entities");
+}
+
+template <typename TComponent, typename ...TArgs>
+void Entity::AddComponent(TArgs&& ...args) {
+	registry->AddComponent<TComponent>(*this, std::forward<TArgs>(args)...);
+}
+
+template <typename TComponent>
+void Registry::RemoveComponent(Entity entity) {
+	const int componentId = Component<TComponent>::GetID();
+	const int entityId = entity.GetId();
+
+	// Only entities that have the component have a slot in its pool
+	if (entityComponentSignatures[entityId].test(componentId)) {
+		if (archetypeStorage) {
+			Signature newSignature = entityComponentSignatures[entityId];
+			newSignature.set(componentId, false);
+			archetypeStorage->RemoveComponent(entityId, componentId, WithoutSharedComponents(newSignature));
+			IncrementComponentVersions(entityComponentSignatures[entityId]);
+		}
+		else {
+			GetComponentPool<TComponent>()->Remove(entityId);
+			componentVersions[componentId]++;
+			needsCompaction |= StableComponent<TComponent>::value;
+		}
+		entityCommands.push_back({ EntityCommandType::RemoveComponent, entity.GetHandle(), componentId });
+	}
+
+	entityComponentSignatures.Mutable(entityId).set(componentId, false);
+
+	Logger::Log("Component ID: " + std::to_string(componentId) + " was removed from entity ID: " + std::to_string(entityId));
+
+	if constexpr (HasColdComponent<TComponent>::value) {
+		RemoveComponent<typename ColdComponent<TComponent>::Type>(entity);
+	}
+}
+
+template<typename TComponent>
+void Entity::RemoveComponent() {
+	registry->RemoveComponent<TComponent>(*this);
+}
+
+template <typename TComponent>
+bool Registry::HasComponent(Entity entity) const {
+	const int componentId = Component<TComponent>::GetID();
+	const int entityId = entity.GetId();
+
+	return entityComponentSignatures[entityId].test(componentId);
+}
 
 template<typename TComponent>
 bool Entity::HasComponent() const {
@@ -270,12 +2414,29 @@ bool Entity::HasComponent() const {
 }
 
 template <typename TComponent>
-TComponent& Registry::GetComponent(Entity entity) const {
+TComponent& Registry::GetComponent(Entity entity) {
+	const int componentId = Component<TComponent>::GetID();
+	const int entityId = entity.GetId();
+
+	if (archetypeStorage) {
+		return *static_cast<TComponent*>(archetypeStorage->GetComponent(entityId, componentId));
+	}
+
+	// Raw pointer access, no reference counting on the hot path
+	return GetComponentPool<TComponent>()->Get(entityId);
+}
+
+template <typename TComponent>
+const TComponent& Registry::GetComponent(Entity entity) const {
 	const int componentId = Component<TComponent>::GetID();
 	const int entityId = entity.GetId();
 
-	std::shared_ptr<Pool<TComponent>> componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
-	return componentPool->Get(entityId);
+	if (archetypeStorage) {
+		return *static_cast<const TComponent*>(archetypeStorage->GetComponent(entityId, componentId));
+	}
+
+	const Pool<TComponent>* pool = GetComponentPool<TComponent>();
+	return pool->Get(entityId);
 }
 
 template<typename TComponent>
@@ -283,16 +2444,537 @@ TComponent& Entity::GetComponent() const {
 	return registry->GetComponent<TComponent>(*this);
 }
 
+template<typename TComponent>
+const TComponent& Entity::ReadComponent() const {
+	return static_cast<const Registry*>(registry)->GetComponent<TComponent>(*this);
+}
+
+template <typename TComponent>
+typename ColdComponent<TComponent>::Type& Registry::GetColdComponent(Entity entity) {
+	return GetComponent<typename ColdComponent<TComponent>::Type>(entity);
+}
+
+template <typename TComponent>
+const typename ColdComponent<TComponent>::Type& Registry::GetColdComponent(Entity entity) const {
+	return GetComponent<typename ColdComponent<TComponent>::Type>(entity);
+}
+
+template<typename TComponent>
+typename ColdComponent<TComponent>::Type& Entity::GetColdComponent() const {
+	return registry->GetColdComponent<TComponent>(*this);
+}
+
+template<typename TComponent>
+const typename ColdComponent<TComponent>::Type& Entity::ReadColdComponent() const {
+	return static_cast<const Registry*>(registry)->GetColdComponent<TComponent>(*this);
+}
+
+template <typename TComponent>
+SharedPool<TComponent>* Registry::GetSharedPool() const {
+	return static_cast<SharedPool<TComponent>*>(sharedComponentPools[Component<TComponent>::GetID()].get());
+}
+
+template <typename TComponent>
+SharedPool<TComponent>* Registry::GetOrCreateSharedPool() {
+	const int componentId = Component<TComponent>::GetID();
+	if (!sharedComponentPools[componentId]) {
+		if (componentId < static_cast<int>(componentPools.size()) && componentPools[componentId]) {
+			Logger::Err("Component ID: " + std::to_string(componentId) + " is already used as a regular component.");
+		}
+		sharedComponentPools[componentId] = std::make_unique<SharedPool<TComponent>>();
+		sharedComponentTypes.set(componentId);
+	}
+	return GetSharedPool<TComponent>();
+}
+
+template <typename TComponent>
+void Registry::AddSharedComponents(const std::vector<Entity>& entities, const TComponent& value) {
+	const int componentId = Component<TComponent>::GetID();
+	SharedPool<TComponent>* sharedPool = GetOrCreateSharedPool<TComponent>();
+
+	// The value is looked up once for the whole batch
+	const int valueIndex = sharedPool->FindOrAddValue(value);
+	for (const auto& entity : entities) {
+		const int entityId = entity.GetId();
+		const bool isAdded = !entityComponentSignatures[entityId].test(componentId);
+		if (isAdded) {
+			entityComponentSignatures.Mutable(entityId).set(componentId);
+			entityCommands.push_back({ EntityCommandType::AddComponent, entity.GetHandle(), componentId });
+		}
+		else {
+			RecordReplacedComponent(componentId, entity.GetHandle());
+		}
+		sharedPool->SetValueIndex(entity.GetHandle(), valueIndex);
+		StampComponentTicks(componentId, entityId, isAdded);
+	}
+	componentVersions[componentId]++;
+
+	Logger::Log("Shared component ID: " + std::to_string(componentId) + " was added to " + std::to_string(entities.size()) + " entities");
+}
+
+template <typename TComponent>
+void Registry::AddSharedComponent(Entity entity, const TComponent& value) {
+	AddSharedComponents<TComponent>(std::vector<Entity>{ entity }, value);
+}
+
+template <typename TComponent>
+void Registry::RemoveSharedComponent(Entity entity) {
+	const int componentId = Component<TComponent>::GetID();
+	const int entityId = entity.GetId();
+
+	if (entityComponentSignatures[entityId].test(componentId)) {
+		GetSharedPool<TComponent>()->RemoveEntityFromPool(entityId);
+		componentVersions[componentId]++;
+		entityCommands.push_back({ EntityCommandType::RemoveComponent, entity.GetHandle(), componentId });
+		entityComponentSignatures.Mutable(entityId).set(componentId, false);
+	}
+
+	Logger::Log("Shared component ID: " + std::to_string(componentId) + " was removed from entity ID: " + std::to_string(entityId));
+}
+
+template <typename TComponent>
+const TComponent& Registry::GetSharedComponent(Entity entity) const {
+	const SharedPool<TComponent>* sharedPool = GetSharedPool<TComponent>();
+	return sharedPool->GetValue(sharedPool->GetValueIndex(entity.GetId()));
+}
+
+template <typename TComponent>
+int Registry::GetSharedValueIndex(Entity entity) const {
+	const SharedPool<TComponent>* sharedPool = GetSharedPool<TComponent>();
+	return sharedPool ? sharedPool->GetValueIndex(entity.GetId()) : -1;
+}
+
+template <typename TComponent, typename TFunc>
+void Registry::ForEachSharedValue(TFunc&& func) {
+	const SharedPool<TComponent>* sharedPool = GetSharedPool<TComponent>();
+	if (!sharedPool) {
+		return;
+	}
+	for (int valueIndex = 0; valueIndex < sharedPool->GetNumValues(); valueIndex++) {
+		const std::vector<EntityHandle>& entities = sharedPool->GetEntities(valueIndex);
+		if (!entities.empty()) {
+			func(sharedPool->GetValue(valueIndex), EntitySpan(entities.data(), entities.data() + entities.size(), this));
+		}
+	}
+}
+
+template <typename TComponent, typename ...TArgs>
+void Entity::AddSharedComponent(TArgs&& ...args) {
+	registry->AddSharedComponent<TComponent>(*this, TComponent(std::forward<TArgs>(args)...));
+}
+
+template <typename TComponent>
+void Entity::RemoveSharedComponent() {
+	registry->RemoveSharedComponent<TComponent>(*this);
+}
+
+template <typename TComponent>
+const TComponent& Entity::GetSharedComponent() const {
+	return registry->GetSharedComponent<TComponent>(*this);
+}
+
+template <typename TComponent>
+Pool<TComponent>* Registry::GetComponentPool() const {
+	const int componentId = Component<TComponent>::GetID();
+	if (componentId >= static_cast<int>(componentPools.size())) {
+		return nullptr;
+	}
+	return static_cast<Pool<TComponent>*>(componentPools[componentId].get());
+}
+
+template <typename ...TComponents, typename TFunc>
+void Registry::ForEachChunk(TFunc&& func) {
+	Signature signature;
+	(signature.set(Component<TComponents>::GetID()), ...);
+
+	// Adapt callbacks that don't take the entity ids
+	auto chunkFunc = [&func](int count, const int* entityIds, TComponents* ...components) {
+		if constexpr (std::is_invocable_v<TFunc&, int, const int*, TComponents*...>) {
+			func(count, entityIds, components...);
+		}
+		else {
+			func(count, components...);
+		}
+	};
+
+	if (archetypeStorage) {
+		if (numDisabledEntities == 0) {
+			archetypeStorage->ForEachChunk<TComponents...>(signature, chunkFunc);
+			return;
+		}
+
+		// Split the chunks into the runs of enabled entities
+		archetypeStorage->ForEachChunk<TComponents...>(signature, [&](int count, const int* entityIds, TComponents* ...components) {
+			for (int first = 0; first < count;) {
+				if (!IsEntityEnabled(entityIds[first])) {
+					first++;
+					continue;
+				}
+				int last = first + 1;
+				while (last < count && IsEntityEnabled(entityIds[last])) {
+					last++;
+				}
+				chunkFunc(last - first, entityIds + first, (components + first)...);
+				first = last;
+			}
+		});
+		return;
+	}
+
+	// Walk the dense array of the first component pool and check the rest per entity
+	using TFirst = std::tuple_element_t<0, std::tuple<TComponents...>>;
+	Pool<TFirst>* firstPool = GetComponentPool<TFirst>();
+	if (!firstPool) {
+		return;
+	}
+	for (int index = 0; index < firstPool->GetSize(); index++) {
+		const int entityId = firstPool->GetEntityId(index);
+		if (entityId != -1 && entityComponentSignatures[entityId].Contains(signature) && IsEntityEnabled(entityId)) {
+			chunkFunc(1, &entityId, &GetComponentPool<TComponents>()->Get(entityId)...);
+		}
+	}
+}
+
+template <typename ...TComponents, typename ...TExcluded>
+ComponentView<TComponents...> Registry::View(Exclude<TExcluded...>) {
+	std::lock_guard<std::mutex> lock(viewCacheMutex);
+	std::unique_ptr<IViewCache>& cache = viewCaches[std::type_index(typeid(ViewKey<std::tuple<TComponents...>, std::tuple<TExcluded...>>))];
+	if (!cache) {
+		cache = std::make_unique<ViewCache<TComponents...>>();
+	}
+	ViewCache<TComponents...>* viewCache = static_cast<ViewCache<TComponents...>*>(cache.get());
+
+	const int componentIds[] = { Component<TComponents>::GetID()..., Component<TExcluded>::GetID()... };
+	const int numComponentIds = static_cast<int>(sizeof(componentIds) / sizeof(int));
+
+	const uint32_t pageVersion = GetPageVersion<TComponents...>();
+	bool isValid = viewCache->isBuilt && viewCache->pageVersion == pageVersion;
+	for (int i = 0; isValid && i < numComponentIds; i++) {
+		isValid = viewCache->componentVersions[i] == componentVersions[componentIds[i]];
+	}
+	if (isValid) {
+		return ComponentView<TComponents...>(this, &viewCache->entries, pageVersion);
+	}
+
+	// Rebuild the cached entries
+	Signature includedSignature;
+	(includedSignature.set(Component<TComponents>::GetID()), ...);
+	Signature excludedSignature;
+	(excludedSignature.set(Component<TExcluded>::GetID()), ...);
+
+	auto& entries = viewCache->entries;
+	entries.clear();
+
+	if (archetypeStorage) {
+		archetypeStorage->ForEachArchetype([&](Archetype& archetype) {
+			const Signature& signature = archetype.GetSignature();
+			if (!signature.Contains(includedSignature) || signature.Intersects(excludedSignature)) {
+				return;
+			}
+			for (int chunkIndex = 0; chunkIndex < archetype.GetNumChunks(); chunkIndex++) {
+				const ArchetypeChunk& chunk = archetype.GetChunk(chunkIndex);
+				for (int row = 0; row < chunk.count; row++) {
+					const int entityId = chunk.entityIds[row];
+					entries.push_back({
+						EntityHandle(entityId, entityGenerations[entityId]),
+						std::make_tuple(static_cast<TComponents*>(archetype.GetComponent(Component<TComponents>::GetID(), chunkIndex, row))...)
+					});
+				}
+			}
+		});
+	}
+	else {
+		// Walk the smallest pool and check the signatures of its entities
+		IPool* smallestPool = nullptr;
+		for (int i = 0; i < static_cast<int>(sizeof...(TComponents)); i++) {
+			IPool* pool = componentIds[i] < static_cast<int>(componentPools.size()) ? componentPools[componentIds[i]].get() : nullptr;
+			if (!pool) {
+				smallestPool = nullptr;
+				break;
+			}
+			if (!smallestPool || pool->GetSize() < smallestPool->GetSize()) {
+				smallestPool = pool;
+			}
+		}
+
+		if (smallestPool) {
+			entries.reserve(smallestPool->GetSize());
+			for (int index = 0; index < smallestPool->GetSize(); index++) {
+				const int entityId = smallestPool->GetEntityId(index);
+				if (entityId == -1) {
+					continue;
+				}
+				const Signature& signature = entityComponentSignatures[entityId];
+				if (!signature.Contains(includedSignature) || signature.Intersects(excludedSignature)) {
+					continue;
+				}
+				// Read access, building a view doesnt count as a write for forked registries
+				entries.push_back({
+					EntityHandle(entityId, entityGenerations[entityId]),
+					std::make_tuple(const_cast<TComponents*>(&static_cast<const Pool<TComponents>*>(GetComponentPool<TComponents>())->Get(entityId))...)
+				});
+			}
+		}
+	}
+
+	viewCache->componentVersions.resize(numComponentIds);
+	for (int i = 0; i < numComponentIds; i++) {
+		viewCache->componentVersions[i] = componentVersions[componentIds[i]];
+	}
+	viewCache->pageVersion = pageVersion;
+	viewCache->isBuilt = true;
+
+	return ComponentView<TComponents...>(this, &viewCache->entries, pageVersion);
+}
+
+template <typename ...TComponents>
+ComponentView<TComponents...> Registry::View() {
+	return View<TComponents...>(Exclude<>());
+}
+
+template <typename ...TComponents, typename TFilter, typename ...TExcluded>
+std::enable_if_t<IsTickFilter<TFilter>::value, ComponentView<TComponents...>> Registry::View(TFilter filter, Exclude<TExcluded...> exclude) {
+	// Filter the structural view, it is rebuilt first if needed
+	View<TComponents...>(exclude);
+
+	std::lock_guard<std::mutex> lock(viewCacheMutex);
+	ViewCache<TComponents...>* viewCache = static_cast<ViewCache<TComponents...>*>(
+		viewCaches[std::type_index(typeid(ViewKey<std::tuple<TComponents...>, std::tuple<TExcluded...>>))].get()
+	);
+
+	// Every call gets its own entries, so an earlier filtered view of the same types stays as it was
+	auto filteredEntries = std::make_shared<std::vector<ViewEntry<TComponents...>>>();
+	for (const auto& entry : viewCache->entries) {
+		if (MatchesTickFilter(filter, entry.entity.GetIndex())) {
+			filteredEntries->push_back(entry);
+		}
+	}
+
+	return ComponentView<TComponents...>(this, std::move(filteredEntries), viewCache->pageVersion);
+}
+
+template <template <typename...> class TFilter, typename ...TFiltered>
+bool Registry::MatchesTickFilter(const TFilter<TFiltered...>& filter, int entityId) const {
+	const Signature& signature = entityComponentSignatures[entityId];
+	return ((signature.test(Component<TFiltered>::GetID()) &&
+		TFilter<TFiltered...>::GetTick(GetComponentTicks(Component<TFiltered>::GetID(), entityId)) > filter.sinceTick) || ...);
+}
+
+template <typename TComponent>
+void Registry::MarkChanged(int entityId) {
+	std::vector<ComponentTicks>& ticks = componentTicks[Component<TComponent>::GetID()];
+	if (entityId < static_cast<int>(ticks.size())) {
+		ticks[entityId].changed = currentTick.load(std::memory_order_relaxed);
+	}
+}
+
+template <typename TComponent>
+bool Registry::HasChanged(int entityId, uint32_t sinceTick) const {
+	return MatchesTickFilter(Changed<TComponent>(sinceTick), entityId);
+}
+
+template <typename TComponent, typename ...TArgs>
+void CommandBuffer::AddComponent(Entity entity, TArgs&& ...args) {
+	Record(false, entity.GetId(), [handle = entity.GetHandle(), component = TComponent(std::forward<TArgs>(args)...)](Registry& registry) {
+		if (registry.IsAlive(handle)) {
+			registry.AddComponent<TComponent>(registry.GetEntity(handle), component);
+		}
+	});
+}
+
+template <typename TComponent>
+void CommandBuffer::RemoveComponent(Entity entity) {
+	Record(false, entity.GetId(), [handle = entity.GetHandle()](Registry& registry) {
+		if (registry.IsAlive(handle)) {
+			registry.RemoveComponent<TComponent>(registry.GetEntity(handle));
+		}
+	});
+}
+
+template <typename TComponent>
+int Registry::AddObserver(ComponentObserver observer) {
+	const int componentId = Component<TComponent>::GetID();
+	componentObservers[componentId].push_back({ nextObserverId, std::move(observer) });
+	observedComponents.set(componentId);
+	return nextObserverId++;
+}
+
+template <typename TComponent>
+void Entity::MarkChanged() const {
+	registry->MarkChanged<TComponent>(GetId());
+}
+
+template <typename TComponent>
+bool Entity::HasChanged(uint32_t sinceTick) const {
+	return registry->HasChanged<TComponent>(GetId(), sinceTick);
+}
+
+template <typename ...TComponents>
+uint32_t Registry::GetPageVersion() const {
+	uint32_t pageVersion = 0;
+	for (const int componentId : { Component<TComponents>::GetID()... }) {
+		if (componentId < static_cast<int>(componentPools.size()) && componentPools[componentId]) {
+			pageVersion += componentPools[componentId]->GetPageVersion();
+		}
+	}
+	return pageVersion;
+}
+
+template <typename ...TComponents>
+bool Registry::CanUseCachedPointers(uint32_t pageVersion) const {
+	for (const int componentId : { Component<TComponents>::GetID()... }) {
+		if (componentId < static_cast<int>(componentPools.size()) && componentPools[componentId] && componentPools[componentId]->SharesPages()) {
+			return false;
+		}
+	}
+	return GetPageVersion<TComponents...>() == pageVersion;
+}
+
+template <typename ...TComponents>
+typename ComponentView<TComponents...>::Iterator ComponentView<TComponents...>::begin() const {
+	const ViewEntry<TComponents...>* last = entries->data() + entries->size();
+	return Iterator(registry, entries->data(), last, registry->CanUseCachedPointers<TComponents...>(pageVersion), registry->numDisabledEntities != 0);
+}
+
+template <typename ...TComponents>
+typename ComponentView<TComponents...>::Iterator ComponentView<TComponents...>::end() const {
+	const ViewEntry<TComponents...>* last = entries->data() + entries->size();
+	return Iterator(registry, last, last, true, false);
+}
+
+template <typename ...TComponents>
+void ComponentView<TComponents...>::Iterator::SkipDisabled() {
+	while (skipsDisabled && entry != last && !registry->IsEntityEnabled(entry->entity.GetIndex())) {
+		entry++;
+	}
+}
+
+template <typename ...TComponents>
+int ComponentView<TComponents...>::GetSize() const {
+	if (registry->numDisabledEntities == 0) {
+		return static_cast<int>(entries->size());
+	}
+	return static_cast<int>(std::count_if(entries->begin(), entries->end(), [this](const ViewEntry<TComponents...>& entry) {
+		return registry->IsEntityEnabled(entry.entity.GetIndex());
+	}));
+}
+
+template <typename ...TComponents>
+bool ComponentView<TComponents...>::IsEmpty() const {
+	return !(begin() != end());
+}
+
+template <typename ...TComponents>
+std::tuple<Entity, TComponents&...> ComponentView<TComponents...>::Iterator::operator *() const {
+	if (!useCachedPointers) {
+		return std::tuple<Entity, TComponents&...>(registry->GetEntity(entry->entity), registry->GetComponent<TComponents>(registry->GetEntity(entry->entity))...);
+	}
+	return std::apply([this](TComponents* ...components) {
+		return std::tuple<Entity, TComponents&...>(registry->GetEntity(entry->entity), *components...);
+	}, entry->components);
+}
+
+template <typename ...TComponents>
+template <typename TFunc>
+void ComponentView<TComponents...>::Each(TFunc&& func) const {
+	const bool skipsDisabled = registry->numDisabledEntities != 0;
+	if (!registry->CanUseCachedPointers<TComponents...>(pageVersion)) {
+		// Pages are shared with a forked registry, every write goes through its pool
+		for (const auto& entry : *entries) {
+			if (skipsDisabled && !registry->IsEntityEnabled(entry.entity.GetIndex())) {
+				continue;
+			}
+			const Entity entity = registry->GetEntity(entry.entity);
+			func(entity, registry->GetComponent<TComponents>(entity)...);
+		}
+		return;
+	}
+	for (const auto& entry : *entries) {
+		if (skipsDisabled && !registry->IsEntityEnabled(entry.entity.GetIndex())) {
+			continue;
+		}
+		std::apply([&](TComponents* ...components) {
+			func(registry->GetEntity(entry.entity), *components...);
+		}, entry.components);
+	}
+}
+
+template <typename ...TComponents>
+template <typename TFunc>
+void ComponentView<TComponents...>::ParallelEach(TFunc&& func, int grainSize) const {
+	const ViewEntry<TComponents...>* first = entries->data();
+	const int numEntries = static_cast<int>(entries->size());
+	const bool skipsDisabled = registry->numDisabledEntities != 0;
+	if (!registry->CanUseCachedPointers<TComponents...>(pageVersion)) {
+		registry->ParallelFor(numEntries, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				if (skipsDisabled && !registry->IsEntityEnabled(first[i].entity.GetIndex())) {
+					continue;
+				}
+				const Entity entity = registry->GetEntity(first[i].entity);
+				func(entity, registry->GetComponent<TComponents>(entity)...);
+			}
+		}, grainSize);
+		return;
+	}
+	registry->ParallelFor(numEntries, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			if (skipsDisabled && !registry->IsEntityEnabled(first[i].entity.GetIndex())) {
+				continue;
+			}
+			std::apply([&](TComponents* ...components) {
+				func(registry->GetEntity(first[i].entity), *components...);
+			}, first[i].components);
+		}
+	}, grainSize);
+}
+
+template <typename TFunc>
+void EntitySpan::ParallelEach(TFunc&& func, int grainSize) const {
+	registry->ParallelFor(size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			func((*this)[i]);
+		}
+	}, grainSize);
+}
+
+template <typename TFunc>
+void Registry::ParallelFor(int count, TFunc&& func, int grainSize) const {
+	if (!jobSystem) {
+		if (count > 0) {
+			func(0, count);
+		}
+		return;
+	}
+	// Every chunk records with the system and a new phase of the caller, commands of a chunk are ordered by its first index
+	CommandBuffer& callerCommandBuffer = GetCommandBuffer();
+	const int systemOrder = callerCommandBuffer.origin.systemOrder;
+	const int phase = ++callerCommandBuffer.origin.phase;
+	jobSystem->ParallelFor(count, grainSize, [&](int begin, int end) {
+		CommandBuffer& commandBuffer = GetCommandBuffer();
+		const CommandBuffer::Origin origin = commandBuffer.origin;
+		commandBuffer.origin = { systemOrder, phase, begin + 1, 0 };
+		func(begin, end);
+		commandBuffer.origin = origin;
+	});
+	// The caller continues in a phase after all of the chunks
+	callerCommandBuffer.origin.phase++;
+}
+
 template <typename TSystem, typename ...TArgs>
 void Registry::AddSystem(TArgs&& ...args) {
 	std::shared_ptr<System> newSystem = std::make_shared<TSystem>(std::forward<TArgs>(args)...);
+	newSystem->registry = this;
 	systems.insert(std::make_pair(std::type_index(typeid(TSystem)), newSystem));
+	RefreshSystemList();
+	AddExistingEntities(*newSystem);
 }
 
 template <typename TSystem>
 void Registry::RemoveSystem() {
 	auto system = systems.find(std::type_index(typeid(TSystem)));
 	systems.erase(system);
+	RefreshSystemList();
 }
 
 template <typename TSystem>
@@ -306,4 +2988,17 @@ TSystem& Registry::GetSystem() const {
 	return *(std::static_pointer_cast<TSystem>(system->second));
 }
 
+template <typename TSystem, typename TFunc>
+void Registry::ScheduleSystem(TFunc&& func) {
+	TSystem& system = GetSystem<TSystem>();
+	scheduledSystems.push_back({ &system, [&system, func = std::forward<TFunc>(func)]() mutable { func(system); } });
+}
+
+template <typename TSystem, typename TFunc>
+void Registry::AddSystemToTickGroup(int tickGroupId, TFunc&& func) {
+	tickGroups[tickGroupId].scheduleUpdates.push_back([this, func = std::forward<TFunc>(func)](double deltaTime) {
+		ScheduleSystem<TSystem>([&func, deltaTime](TSystem& system) { func(system, deltaTime); });
+	});
+}
+
 #endif
\ No newline at end of file
@@ -6,25 +6,32 @@
 #include "../Components/SpriteComponent.h"
 #include "../Components/AnimationComponent.h"
 #include "../Components/BoxColliderComponent.h"
+#include "../Components/ParentComponent.h"
+#include "../Components/TileComponent.h"
 #include "../Systems/MovementSystem.h"
 #include "../Systems/RenderSystem.h"
+#include "../Systems/TilemapRenderSystem.h"
 #include "../Systems/AnimationSystem.h"
 #include "../Systems/CollisionSystem.h"
 #include "../Systems/RenderCollisionSystem.h"
 #include "../Systems/DamageSystem.h"
+#include "../Systems/HierarchySystem.h"
 #include "SDL.h"
 #include "SDL_image.h"
 #include <glm/glm.hpp>
 #include <iostream>
 #include <fstream>
+#include <chrono>
 
-Game::Game() {
+Game::Game(StorageBackend storageBackend) {
 	isRunning = false;
 	isDebug = false;
 	Logger::Log("Game constructor called!");
-	registry = std::make_unique<Registry>();
+	registry = std::make_unique<Registry>(storageBackend);
 	assetStore = std::make_unique<AssetStore>();
 	eventBus = std::make_unique<EventBus>();
+	jobSystem = std::make_unique<JobSystem>();
+	registry->SetJobSystem(jobSystem.get());
 }
 
 Game::~Game() {
@@ -74,17 +81,34 @@ void Game::LoadLevel(int level) {
 	// Adding systems to the game
 	registry->AddSystem<MovementSystem>();
 	registry->AddSystem<RenderSystem>();
+	registry->AddSystem<TilemapRenderSystem>();
 	registry->AddSystem<AnimationSystem>();
 	registry->AddSystem<CollisionSystem>();
 	registry->AddSystem<RenderCollisionSystem>();
 	registry->AddSystem<DamageSystem>();
+	registry->AddSystem<HierarchySystem>();
 
-	// Adding assets to the asset store
-	assetStore->AddTexture(renderer, "tank-image", "./assets/images/tank-panther-right.png");
-	assetStore->AddTexture(renderer, "truck-image", "./assets/images/truck-ford-right.png");
-	assetStore->AddTexture(renderer, "tilemap-image", "./assets/tilemaps/jungle.png");
-	assetStore->AddTexture(renderer, "chopper-image", "./assets/images/chopper.png");
-	assetStore->AddTexture(renderer, "radar-image", "./assets/images/radar.png");
+	// Animations only change how sprites look, so they are spread over a few frames and capped in time per frame
+	registry->GetSystem<AnimationSystem>().SetTimeSlicing(ANIMATION_TIME_SLICES, ANIMATION_TIME_BUDGET_MILLISECONDS);
+
+	// Children store the handles of their parents, they are remapped as soon as Compact renumbers the parents
+	registry->AddRemapObserver([this](const HandleRemap& remappedHandles) { registry->GetSystem<HierarchySystem>().RemapParents(remappedHandles); });
+
+	// Movement ticks at a fixed rate so it doesn't depend on the frame rate, the rest once per frame
+	const int physicsTickGroup = registry->AddTickGroup(PHYSICS_TICKS_PER_SECOND);
+	registry->AddSystemToTickGroup<MovementSystem>(physicsTickGroup, [](MovementSystem& system, double deltaTime) { system.Update(deltaTime); });
+	registry->AddSystemToTickGroup<HierarchySystem>(physicsTickGroup, [](HierarchySystem& system, double) { system.Update(); });
+
+	const int frameTickGroup = registry->AddTickGroup(0.0);
+	registry->AddSystemToTickGroup<AnimationSystem>(frameTickGroup, [](AnimationSystem& system, double) { system.Update(); });
+	registry->AddSystemToTickGroup<CollisionSystem>(frameTickGroup, [this](CollisionSystem& system, double) { system.Update(eventBus); });
+
+	// Adding assets to the asset store, sprites refer to them by handle
+	const AssetHandle tankImage = assetStore->AddTexture(renderer, "tank-image", "./assets/images/tank-panther-right.png");
+	const AssetHandle truckImage = assetStore->AddTexture(renderer, "truck-image", "./assets/images/truck-ford-right.png");
+	const AssetHandle tilemapImage = assetStore->AddTexture(renderer, "tilemap-image", "./assets/tilemaps/jungle.png");
+	const AssetHandle chopperImage = assetStore->AddTexture(renderer, "chopper-image", "./assets/images/chopper.png");
+	const AssetHandle radarImage = assetStore->AddTexture(renderer, "radar-image", "./assets/images/radar.png");
 
 	// Load tilemap
 	int tileSize = 32;
@@ -99,6 +123,9 @@ void Game::LoadLevel(int level) {
 		return;
 	}
 	else {
+		// Read all the tile source rectangles first, then create the tiles in one batch
+		std::vector<glm::ivec2> tileSourceRects;
+		tileSourceRects.reserve(mapNumRows * mapNumCols);
 		for (int row = 0; row < mapNumRows; row++) {
 			for (int col = 0; col < mapNumCols; col++) {
 				char ch;
@@ -108,45 +135,121 @@ void Game::LoadLevel(int level) {
 				int sourceRectX = atoi(&ch) * tileSize;
 				mapFile.ignore();
 
-				Entity tile = registry->CreateEntity();
-				tile.AddComponent<TransformComponent>(
-					glm::vec2(col * tileSize * tileScale, row * tileSize * tileScale),
-					glm::vec2(tileScale, tileScale),
-					0.0
-				);
-				tile.AddComponent<SpriteComponent>("tilemap-image", tileSize, tileSize, 0, sourceRectX, sourceRectY);
+				tileSourceRects.emplace_back(sourceRectX, sourceRectY);
 			}
 		}
 		mapFile.close();
+
+		std::vector<Entity> tiles = registry->CreateEntities(mapNumRows * mapNumCols);
+		registry->AddComponents<TransformComponent>(tiles, [&](int i) {
+			const int row = i / mapNumCols;
+			const int col = i % mapNumCols;
+			return TransformComponent(
+				glm::vec2(col * tileSize * tileScale, row * tileSize * tileScale),
+				glm::vec2(tileScale, tileScale),
+				0.0
+			);
+		});
+		registry->AddComponents<TileComponent>(tiles, [&](int i) {
+			return TileComponent(tileSourceRects[i].x, tileSourceRects[i].y, tileSize, tileSize);
+		});
+		// Every tile uses the same texture and size, so they are stored once
+		registry->AddSharedComponents<TilemapComponent>(tiles, TilemapComponent(tilemapImage, tileSize, tileSize));
 	}
 	
 	// Create entities
 	Entity chopper = registry->CreateEntity();
+	chopper.Tag("player");
 	chopper.AddComponent<TransformComponent>(glm::vec2(10.0, 100.0), glm::vec2(1.0, 1.0), 0.0);
 	chopper.AddComponent<RigidBodyComponent>(glm::vec2(0.0, 0.0));
-	chopper.AddComponent<SpriteComponent>("chopper-image", 32, 32, 2);
+	chopper.AddComponent<SpriteComponent>(chopperImage, 32, 32);
+	chopper.AddComponent<SpriteColdComponent>(2);
 	chopper.AddComponent<AnimationComponent>(2, 15, true);
 	
 	Entity radar = registry->CreateEntity();
 	radar.AddComponent<TransformComponent>(glm::vec2(windowWidth - 74, 10), glm::vec2(1.0, 1.0), 0.0);
 	radar.AddComponent<RigidBodyComponent>(glm::vec2(0.0, 0.0));
-	radar.AddComponent<SpriteComponent>("radar-image", 64, 64, 2);
+	radar.AddComponent<SpriteComponent>(radarImage, 64, 64);
+	radar.AddComponent<SpriteColdComponent>(2);
 	radar.AddComponent<AnimationComponent>(8, 8, true);
 	
-	Entity tank = registry->CreateEntity();
+	// Vehicles are spawned from prefabs
+	Prefab tank;
 	tank.AddComponent<TransformComponent>(glm::vec2(500.0, 10.0), glm::vec2(1.0, 1.0), 0.0);
 	tank.AddComponent<RigidBodyComponent>(glm::vec2(-30.0, 0.0));
-	tank.AddComponent<SpriteComponent>("tank-image", 32, 32, 2);
+	tank.AddComponent<SpriteComponent>(tankImage, 32, 32);
+	tank.AddComponent<SpriteColdComponent>(2);
 	tank.AddComponent<BoxColliderComponent>(32, 32);
+	registry->Instantiate(tank)[0].Group("enemies");
 
-	Entity truck = registry->CreateEntity();
+	Prefab truck;
 	truck.AddComponent<TransformComponent>(glm::vec2(10.0, 10.0), glm::vec2(1.0, 1.0), 0.0);
 	truck.AddComponent<RigidBodyComponent>(glm::vec2(20.0, 0.0));
-	truck.AddComponent<SpriteComponent>("truck-image", 32, 32, 1);
+	truck.AddComponent<SpriteComponent>(truckImage, 32, 32);
+	truck.AddComponent<SpriteColdComponent>(1);
 	truck.AddComponent<BoxColliderComponent>(32, 32);
+	registry->Instantiate(truck)[0].Group("enemies");
 }
 
 void Game::Setup() {
+	// Fix the component ids so they dont depend on which component is used first
+	RegisterComponentTypes<
+		TransformComponent,
+		RigidBodyComponent,
+		SpriteComponent,
+		SpriteColdComponent,
+		AnimationComponent,
+		BoxColliderComponent,
+		ParentComponent,
+		TileComponent,
+		TilemapComponent
+	>();
+
+	// Names and members of the component types for tools and serialization
+	DescribeComponentType<TransformComponent>("TransformComponent", {
+		COMPONENT_FIELD(TransformComponent, position),
+		COMPONENT_FIELD(TransformComponent, scale),
+		COMPONENT_FIELD(TransformComponent, rotation)
+	});
+	DescribeComponentType<RigidBodyComponent>("RigidBodyComponent", {
+		COMPONENT_FIELD(RigidBodyComponent, velocity)
+	});
+	DescribeComponentType<SpriteComponent>("SpriteComponent", {
+		COMPONENT_FIELD(SpriteComponent, assetHandle),
+		COMPONENT_FIELD(SpriteComponent, width),
+		COMPONENT_FIELD(SpriteComponent, height),
+		COMPONENT_FIELD(SpriteComponent, srcRect)
+	});
+	DescribeComponentType<SpriteColdComponent>("SpriteColdComponent", {
+		COMPONENT_FIELD(SpriteColdComponent, zIndex)
+	});
+	DescribeComponentType<AnimationComponent>("AnimationComponent", {
+		COMPONENT_FIELD(AnimationComponent, numFrames),
+		COMPONENT_FIELD(AnimationComponent, currentFrame),
+		COMPONENT_FIELD(AnimationComponent, frameSpeedRate),
+		COMPONENT_FIELD(AnimationComponent, isLoop),
+		COMPONENT_FIELD(AnimationComponent, startTime)
+	});
+	DescribeComponentType<BoxColliderComponent>("BoxColliderComponent", {
+		COMPONENT_FIELD(BoxColliderComponent, width),
+		COMPONENT_FIELD(BoxColliderComponent, height),
+		COMPONENT_FIELD(BoxColliderComponent, offset)
+	});
+	DescribeComponentType<ParentComponent>("ParentComponent", {
+		COMPONENT_FIELD(ParentComponent, parent),
+		COMPONENT_FIELD(ParentComponent, localPosition),
+		COMPONENT_FIELD(ParentComponent, localScale),
+		COMPONENT_FIELD(ParentComponent, localRotation)
+	});
+	DescribeComponentType<TileComponent>("TileComponent", {
+		COMPONENT_FIELD(TileComponent, srcRect)
+	});
+	DescribeComponentType<TilemapComponent>("TilemapComponent", {
+		COMPONENT_FIELD(TilemapComponent, assetHandle),
+		COMPONENT_FIELD(TilemapComponent, width),
+		COMPONENT_FIELD(TilemapComponent, height)
+	});
+
 	LoadLevel(1);
 }
 
@@ -159,6 +262,49 @@ void Game::Run() {
 	}
 }
 
+void Game::RunBenchmark(int numFrames) {
+	numFrames = std::max(numFrames, 1);
+	Setup();
+
+	double animationMilliseconds = 0.0;
+	double renderMilliseconds = 0.0;
+	size_t animationBytes = 0;
+	size_t renderBytes = 0;
+	size_t unsplitBytes = 0;
+	for (int frame = 0; frame < numFrames; frame++) {
+		registry->Update();
+
+		// Bytes are a model, not a measurement: the entities each pass visits times the size of the components it reads
+		const size_t numAnimated = registry->GetSystem<AnimationSystem>().GetSystemEntities().size();
+		const size_t numRendered = registry->GetSystem<RenderSystem>().GetSystemEntities().size();
+		const size_t numTiles = registry->GetSystem<TilemapRenderSystem>().GetSystemEntities().size();
+		animationBytes += numAnimated * (sizeof(SpriteComponent) + sizeof(AnimationComponent));
+		renderBytes += numRendered * (sizeof(RenderableEntity) + sizeof(TransformComponent) + sizeof(SpriteComponent));
+		renderBytes += numTiles * (sizeof(EntityHandle) + sizeof(TransformComponent) + sizeof(TileComponent));
+		// The same model with zIndex back in SpriteComponent, both passes would also read it
+		unsplitBytes += (numAnimated + numRendered) * sizeof(SpriteColdComponent);
+
+		const auto animationStart = std::chrono::steady_clock::now();
+		registry->GetSystem<AnimationSystem>().Update();
+		const auto animationEnd = std::chrono::steady_clock::now();
+		animationMilliseconds += std::chrono::duration<double, std::milli>(animationEnd - animationStart).count();
+
+		SDL_RenderClear(renderer);
+		const auto renderStart = std::chrono::steady_clock::now();
+		registry->GetSystem<TilemapRenderSystem>().Update(renderer, assetStore);
+		registry->GetSystem<RenderSystem>().Update(renderer, assetStore);
+		const auto renderEnd = std::chrono::steady_clock::now();
+		renderMilliseconds += std::chrono::duration<double, std::milli>(renderEnd - renderStart).count();
+		SDL_RenderPresent(renderer);
+	}
+
+	const size_t streamedBytes = (animationBytes + renderBytes) / numFrames;
+	Logger::Log("Benchmark over " + std::to_string(numFrames) + " frames");
+	Logger::Log("Animation pass: " + std::to_string(animationMilliseconds / numFrames) + " ms measured, " + std::to_string(animationBytes / numFrames) + " bytes per frame estimated");
+	Logger::Log("Render pass: " + std::to_string(renderMilliseconds / numFrames) + " ms measured, " + std::to_string(renderBytes / numFrames) + " bytes per frame estimated");
+	Logger::Log("Estimated component bytes read per frame: " + std::to_string(streamedBytes) + ", modeled with zIndex in SpriteComponent: " + std::to_string(streamedBytes + unsplitBytes / numFrames));
+}
+
 void Game::ProcessInput() {
 	SDL_Event sdlEvent;
 	while (SDL_PollEvent(&sdlEvent)) {
@@ -200,18 +346,21 @@ void Game::Update() {
 
 	// Update the registry to create and destroy entities that are pending
 	registry->Update();
+
+	// Spread the renumbering of entities and the shrinking of pools over the frames after kills
+	registry->Compact();
 	
-	// Update all systems that need an update
-	registry->GetSystem<MovementSystem>().Update(deltaTime);
-	registry->GetSystem<AnimationSystem>().Update();
-	registry->GetSystem<CollisionSystem>().Update(eventBus);
+	// Update all systems that need an update, each tick group at its own rate
+	// Systems that don't touch the same components run at the same time
+	registry->RunTickGroups(deltaTime);
 }
 
 void Game::Render() {
 	SDL_SetRenderDrawColor(renderer, 21, 21, 21, 255);
 	SDL_RenderClear(renderer);
 
-	// Update all systems that need an update
+	// Update all systems that need an update, tiles first so sprites are drawn over them
+	registry->GetSystem<TilemapRenderSystem>().Update(renderer, assetStore);
 	registry->GetSystem<RenderSystem>().Update(renderer, assetStore);
 	if (isDebug) {
 		registry->GetSystem<RenderCollisionSystem>().Update(renderer);
@@ -4,11 +4,16 @@
 #include "../ECS/ECS.h"
 #include "../AssetStore/AssetStore.h"
 #include "../EventBus/EventBus.h"
+#include "../JobSystem/JobSystem.h"
 #include <SDL.h>
 #include <memory>
 
 const int FPS = 60;
 const int MILISECS_PER_FRAME = 1000 / FPS;
+const double PHYSICS_TICKS_PER_SECOND = 120.0;
+const int BENCHMARK_FRAMES = 600;
+const int ANIMATION_TIME_SLICES = 2;
+const double ANIMATION_TIME_BUDGET_MILLISECONDS = 1.0;
 
 class Game
 {
@@ -22,15 +27,21 @@ private:
 	std::unique_ptr<Registry> registry;
 	std::unique_ptr<AssetStore> assetStore;
 	std::unique_ptr<EventBus> eventBus;
+	std::unique_ptr<JobSystem> jobSystem;
 
 public:
-	Game();
+	Game(StorageBackend storageBackend = StorageBackend::SparseSet);
 	~Game();
 
 	void Initialize();
 	void LoadLevel(int level);
 	void Setup();
 	void Run();
+
+	// Loads the level and runs the animation and render passes back to back for numFrames frames
+	// Logs their measured time per frame, the component bytes are an estimate from the component sizes and entity counts
+	// The estimate with zIndex in SpriteComponent is modeled the same way, only the times are measured
+	void RunBenchmark(int numFrames);
 	void ProcessInput();
 	void Update();
 	void Render();
@@ -0,0 +1,179 @@
+#include "JobSystem.h"
+#include "../Logger/Logger.h"
+#include <algorithm>
+
+// Job system and queue index of the current thread, only set on workers
+static thread_local const JobSystem* currentJobSystem = nullptr;
+static thread_local int currentWorkerIndex = -1;
+
+JobSystem::JobSystem(int numWorkers) {
+	if (numWorkers < 0) {
+		numWorkers = std::max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+	}
+	for (int i = 0; i <= numWorkers; i++) {
+		queues.push_back(std::make_unique<JobQueue>());
+	}
+	workers.reserve(numWorkers);
+	for (int i = 0; i < numWorkers; i++) {
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+	Logger::Log("Job system started with " + std::to_string(numWorkers) + " workers");
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		isStopping = true;
+	}
+	sleepCondition.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+int JobSystem::GetNumWorkers() const {
+	return static_cast<int>(workers.size());
+}
+
+int JobSystem::GetCurrentThreadIndex() const {
+	return GetQueueIndex();
+}
+
+int JobSystem::GetQueueIndex() const {
+	return currentJobSystem == this ? currentWorkerIndex : GetNumWorkers();
+}
+
+void JobSystem::Push(Job job) {
+	JobQueue& queue = *queues[GetQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+	numQueuedJobs.fetch_add(1, std::memory_order_release);
+	{
+		// Taking the lock makes sure a worker about to sleep sees the new job
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	sleepCondition.notify_one();
+}
+
+bool JobSystem::TryRunJob() {
+	if (numQueuedJobs.load(std::memory_order_acquire) == 0) {
+		return false;
+	}
+
+	const int numQueues = static_cast<int>(queues.size());
+	const int ownIndex = GetQueueIndex();
+	Job job;
+
+	// Newest job of the own queue first, it is the most likely to be in cache
+	{
+		JobQueue& queue = *queues[ownIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+	}
+
+	// Otherwise steal the oldest job of another queue
+	for (int i = 1; !job && i < numQueues; i++) {
+		JobQueue& queue = *queues[(ownIndex + i) % numQueues];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+	}
+
+	if (!job) {
+		return false;
+	}
+	numQueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+	job();
+	return true;
+}
+
+void JobSystem::WaitUntilZero(const std::atomic<int>& value) {
+	while (value.load(std::memory_order_acquire) > 0) {
+		if (!TryRunJob()) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::WorkerLoop(int workerIndex) {
+	currentJobSystem = this;
+	currentWorkerIndex = workerIndex;
+	while (true) {
+		if (TryRunJob()) {
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepCondition.wait(lock, [this]() { return isStopping || numQueuedJobs.load(std::memory_order_acquire) > 0; });
+		if (isStopping && numQueuedJobs.load(std::memory_order_acquire) == 0) {
+			return;
+		}
+	}
+}
+
+void JobSystem::Run(Job job, JobCounter* counter) {
+	if (!counter) {
+		Push(std::move(job));
+		return;
+	}
+	counter->value.fetch_add(1, std::memory_order_relaxed);
+	Push([job = std::move(job), counter]() {
+		job();
+		counter->value.fetch_sub(1, std::memory_order_acq_rel);
+	});
+}
+
+void JobSystem::Wait(const JobCounter& counter) {
+	WaitUntilZero(counter.value);
+}
+
+void JobSystem::RunChunks(ParallelForBatch& batch) {
+	while (true) {
+		const int chunk = batch.nextChunk.fetch_add(1, std::memory_order_relaxed);
+		if (chunk >= batch.numChunks) {
+			return;
+		}
+		const int begin = chunk * batch.chunkSize;
+		const int end = std::min(begin + batch.chunkSize, batch.count);
+		(*batch.func)(begin, end);
+		batch.pendingChunks.fetch_sub(1, std::memory_order_acq_rel);
+	}
+}
+
+void JobSystem::ParallelFor(int count, int grainSize, const std::function<void(int, int)>& func) {
+	if (count <= 0) {
+		return;
+	}
+
+	// Round the grain up to whole cache lines worth of elements
+	grainSize = std::max(grainSize, 1);
+	const int chunkSize = (grainSize + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+
+	if (workers.empty() || count <= chunkSize) {
+		func(0, count);
+		return;
+	}
+
+	auto batch = std::make_shared<ParallelForBatch>();
+	batch->func = &func;
+	batch->count = count;
+	batch->chunkSize = chunkSize;
+	batch->numChunks = (count + chunkSize - 1) / chunkSize;
+	batch->pendingChunks.store(batch->numChunks, std::memory_order_relaxed);
+
+	// The caller takes chunks too, so only queue as many helpers as there are chunks left for them
+	// Helpers that start after the last chunk was taken return right away
+	const int numHelpers = std::min(GetNumWorkers(), batch->numChunks - 1);
+	for (int i = 0; i < numHelpers; i++) {
+		Push([batch]() { RunChunks(*batch); });
+	}
+
+	RunChunks(*batch);
+	WaitUntilZero(batch->pendingChunks);
+}
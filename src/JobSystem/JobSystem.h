@@ -0,0 +1,90 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+const int CACHE_LINE_SIZE = 64;
+
+// Default number of elements handed to a worker at once
+const int DEFAULT_GRAIN_SIZE = 256;
+
+typedef std::function<void()> Job;
+
+// Number of unfinished jobs, incremented by Run and decremented when the job is done
+struct JobCounter {
+	std::atomic<int> value{ 0 };
+};
+
+// JobSystem
+// Pool of worker threads with one job deque each
+// Workers pop their own newest jobs first and steal the oldest jobs of the others when they run dry
+// Threads waiting for jobs keep running queued jobs, so jobs may wait for other jobs
+class JobSystem {
+private:
+	struct alignas(CACHE_LINE_SIZE) JobQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	// One parallel for in flight, shared by the caller and every job helping with it
+	struct ParallelForBatch {
+		const std::function<void(int, int)>* func = nullptr;
+		int count = 0;
+		int chunkSize = 0;
+		int numChunks = 0;
+		std::atomic<int> nextChunk{ 0 };
+		std::atomic<int> pendingChunks{ 0 };
+	};
+
+	std::vector<std::thread> workers;
+
+	// One queue per worker, the last one takes jobs from threads that are not workers
+	std::vector<std::unique_ptr<JobQueue>> queues;
+
+	// Sleeping workers wait for numQueuedJobs to become non zero
+	std::atomic<int> numQueuedJobs{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	bool isStopping = false;
+
+	int GetQueueIndex() const;
+	void Push(Job job);
+	bool TryRunJob();
+	void WaitUntilZero(const std::atomic<int>& value);
+	void WorkerLoop(int workerIndex);
+	static void RunChunks(ParallelForBatch& batch);
+
+public:
+	// Uses one worker less than the hardware threads, the caller is the last one
+	JobSystem(int numWorkers = -1);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator =(const JobSystem&) = delete;
+
+	int GetNumWorkers() const;
+
+	// Index of the calling thread, workers are 0 to GetNumWorkers() - 1 and every other thread gets GetNumWorkers()
+	int GetCurrentThreadIndex() const;
+
+	// Queues a job, counter (if any) stays above zero until the job is done
+	void Run(Job job, JobCounter* counter = nullptr);
+
+	// Runs queued jobs until the counter drops to zero
+	void Wait(const JobCounter& counter);
+
+	// Calls func(begin, end) for consecutive ranges covering [0, count) and returns when all of them are done
+	// Ranges are a multiple of CACHE_LINE_SIZE elements, so for any element size neighbouring ranges
+	// of a cache line aligned array never write to the same cache line
+	// Counts up to the grain size run serially on the calling thread
+	void ParallelFor(int count, int grainSize, const std::function<void(int, int)>& func);
+};
+
+#endif
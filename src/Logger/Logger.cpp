@@ -3,6 +3,7 @@
 #include <string>
 #include <chrono>
 #include <ctime>
+#include <mutex>
 
 const std::string consoleColorWhite = "\033[0m";
 const std::string consoleColorGreen = "\x1B[32m";
@@ -10,6 +11,9 @@ const std::string consoleColorRed = "\x1B[91m";
 
 std::vector<LogEntry> Logger::messages;
 
+// Systems may log from worker threads
+static std::mutex loggerMutex;
+
 std::string CurrentDateTimeToString() {
 	std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
 	std::string output(30, '\0');
@@ -23,6 +27,7 @@ void Logger::Log(const std::string& message) {
 	LogEntry entry;
 	entry.type = LogType::LOG_INFO;
 	entry.message = "LOG: [" + CurrentDateTimeToString() + "]: " + message;
+	std::lock_guard<std::mutex> lock(loggerMutex);
 	std::cout << consoleColorGreen << entry.message << consoleColorWhite << std::endl;
 	messages.push_back(entry);
 }
@@ -31,6 +36,7 @@ void Logger::Err(const std::string& message) {
 	LogEntry entry;
 	entry.type = LogType::LOG_ERROR;
 	entry.message = "ERR: [" + CurrentDateTimeToString() + "]: " + message;
+	std::lock_guard<std::mutex> lock(loggerMutex);
 	std::cerr << consoleColorRed << entry.message << consoleColorWhite << std::endl;
 	messages.push_back(entry);
 }
\ No newline at end of file
@@ -1,10 +1,29 @@
 #include "Game/Game.h"
+#include <string>
 
 int main(int argc, char* argv[]) {
-	Game game;
+	// Pass --archetype to run the game on the archetype storage backend
+	// Pass --benchmark to run the animation and render passes for a fixed number of frames and log what they read
+	StorageBackend storageBackend = StorageBackend::SparseSet;
+	bool isBenchmark = false;
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--archetype") {
+			storageBackend = StorageBackend::Archetype;
+		}
+		if (std::string(argv[i]) == "--benchmark") {
+			isBenchmark = true;
+		}
+	}
+
+	Game game(storageBackend);
 
 	game.Initialize();
-	game.Run();
+	if (isBenchmark) {
+		game.RunBenchmark(BENCHMARK_FRAMES);
+	}
+	else {
+		game.Run();
+	}
 	game.Destroy();
 
     return 0;
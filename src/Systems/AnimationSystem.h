@@ -10,16 +10,25 @@ public:
 	AnimationSystem() {
 		RequireComponent<SpriteComponent>();
 		RequireComponent<AnimationComponent>();
+
+		WritesComponent<SpriteComponent>();
+		WritesComponent<AnimationComponent>();
 	}
 
+	// Only advances the slice of the animations set with SetTimeSlicing, the frame comes from the time
+	// so an animation that waits for its slice shows the right frame again once it gets its turn
 	void Update() {
-		for (auto entity: GetSystemEntities()) {
+		const Uint32 ticks = SDL_GetTicks();
+		ForEachTimeSlicedEntity([ticks](Entity entity) {
 			auto& sprite = entity.GetComponent<SpriteComponent>();
 			auto& animation = entity.GetComponent<AnimationComponent>();
-
-			animation.currentFrame = (SDL_GetTicks() - animation.startTime) * animation.frameSpeedRate / 1000 % animation.numFrames;
-			sprite.srcRect.x = animation.currentFrame * sprite.width;
-		}
+			animation.currentFrame = (ticks - animation.startTime) * animation.frameSpeedRate / 1000 % animation.numFrames;
+			const int frameX = animation.currentFrame * sprite.width;
+			if (sprite.srcRect.x != frameX) {
+				sprite.srcRect.x = frameX;
+				entity.MarkChanged<SpriteComponent>();
+			}
+		});
 	}
 };
 
@@ -13,21 +13,24 @@ public:
 	CollisionSystem() {
 		RequireComponent<TransformComponent>();
 		RequireComponent<BoxColliderComponent>();
+
+		ReadsComponent<TransformComponent>();
+		ReadsComponent<BoxColliderComponent>();
 	}
 
 	void Update(std::unique_ptr<EventBus>& eventBus) {
-		auto entities = GetSystemEntities();
+		const auto entities = GetSystemEntities();
 		// Loop all entities the system is interested in
 		for (auto i = entities.begin(); i != entities.end(); i++) {
 			Entity entity = *i;
-			auto& transform = entity.GetComponent<TransformComponent>();
-			auto& collider = entity.GetComponent<BoxColliderComponent>();
+			const auto& transform = entity.ReadComponent<TransformComponent>();
+			const auto& collider = entity.ReadComponent<BoxColliderComponent>();
 			// Loop only entities that havent been compared yet
 			// Reduces the number of comparisons
 			for (auto j = i + 1; j != entities.end(); j++) {
 				Entity otherEntity = *j;
-				auto& otherTransform = otherEntity.GetComponent<TransformComponent>();
-				auto& otherCollider = otherEntity.GetComponent<BoxColliderComponent>();
+				const auto& otherTransform = otherEntity.ReadComponent<TransformComponent>();
+				const auto& otherCollider = otherEntity.ReadComponent<BoxColliderComponent>();
 
 				if (CheckAABBCollision(
 					transform.position.x + collider.offset.x,
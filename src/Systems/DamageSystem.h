@@ -19,8 +19,10 @@ public:
 
 	void OnCollision(CollisionEvent& e) {
 		Logger::Log("The Damage system received an event collision between entities" + std::to_string(e.entity1.GetId()) + " and " + std::to_string(e.entity2.GetId()));
-		e.entity1.Kill();
-		e.entity2.Kill();
+		// Collisions are detected on a worker, the kills are applied in the next Update
+		CommandBuffer& commandBuffer = registry->GetCommandBuffer();
+		commandBuffer.KillEntity(e.entity1);
+		commandBuffer.KillEntity(e.entity2);
 	}
 
 	void Update() {
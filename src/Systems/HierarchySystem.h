@@ -0,0 +1,161 @@
+#ifndef HIERARCHYSYSTEM_H
+#define HIERARCHYSYSTEM_H
+
+#include "../Logger/Logger.h"
+#include "../ECS/ECS.h"
+#include "../Components/TransformComponent.h"
+#include "../Components/ParentComponent.h"
+#include <vector>
+#include <unordered_map>
+#include <cmath>
+#include <glm/glm.hpp>
+
+class HierarchySystem : public System {
+private:
+	// Children grouped by their depth below a root, all parents of a batch were updated by the batches before it
+	std::vector<std::vector<EntityHandle>> depthBatches;
+
+	uint32_t batchedMembershipVersion = UINT32_MAX;
+	uint32_t lastTick = 0;
+
+	// Follows the parents until an entity outside the hierarchy, depths already known are reused
+	int GetDepth(Entity entity, std::unordered_map<int, int>& depths) {
+		std::vector<int> chain;
+		int depth = 0;
+		while (true) {
+			auto knownDepth = depths.find(entity.GetId());
+			if (knownDepth != depths.end()) {
+				depth = knownDepth->second;
+				break;
+			}
+			if (!HasEntity(entity) || static_cast<int>(chain.size()) > GetSystemEntities().size()) {
+				if (HasEntity(entity)) {
+					Logger::Err("Entity " + std::to_string(entity.GetId()) + " is part of a parent cycle.");
+				}
+				break;
+			}
+			chain.push_back(entity.GetId());
+			const EntityHandle parent = entity.ReadComponent<ParentComponent>().parent;
+			if (!registry->IsAlive(parent)) {
+				break;
+			}
+			entity = registry->GetEntity(parent);
+		}
+
+		for (auto id = chain.rbegin(); id != chain.rend(); id++) {
+			depths[*id] = ++depth;
+		}
+		return depth;
+	}
+
+	void RebuildDepthBatches() {
+		for (auto& batch : depthBatches) {
+			batch.clear();
+		}
+
+		std::unordered_map<int, int> depths;
+		for (auto entity : GetSystemEntities()) {
+			const int depth = GetDepth(entity, depths);
+			if (depth > static_cast<int>(depthBatches.size())) {
+				depthBatches.resize(depth);
+			}
+			depthBatches[depth - 1].push_back(entity.GetHandle());
+		}
+
+		while (!depthBatches.empty() && depthBatches.back().empty()) {
+			depthBatches.pop_back();
+		}
+	}
+
+public:
+	HierarchySystem() {
+		RequireComponent<TransformComponent>();
+		RequireComponent<ParentComponent>();
+
+		WritesComponent<TransformComponent>();
+		WritesComponent<ParentComponent>();
+	}
+
+	// Registered as remap observer, replaces the handles of parents that Registry::Compact renumbered
+	void RemapParents(const HandleRemap& remappedHandles) {
+		for (auto entity : GetAllSystemEntities()) {
+			auto& parentComponent = entity.GetComponent<ParentComponent>();
+			auto remapped = remappedHandles.find(parentComponent.parent.value);
+			if (remapped != remappedHandles.end()) {
+				parentComponent.parent = remapped->second;
+			}
+		}
+	}
+
+	// Children see the transforms of their parents written earlier in the same update as changed,
+	// the next update only looks at changes made after this one finished
+	void Update() {
+		const uint32_t sinceTick = lastTick;
+
+		// Reparenting can change depths, so it regroups the batches like entities coming and going
+		const bool isRebuilt = GetMembershipVersion() != batchedMembershipVersion || !registry->View<ParentComponent>(Changed<ParentComponent>(sinceTick)).IsEmpty();
+		if (isRebuilt) {
+			RebuildDepthBatches();
+			batchedMembershipVersion = GetMembershipVersion();
+		}
+
+		std::vector<char> isOrphan;
+		for (const auto& batch : depthBatches) {
+			isOrphan.assign(batch.size(), 0);
+
+			registry->ParallelFor(static_cast<int>(batch.size()), [&](int begin, int end) {
+				for (int i = begin; i < end; i++) {
+					const Entity entity = registry->GetEntity(batch[i]);
+					auto& parentComponent = entity.GetComponent<ParentComponent>();
+
+					// A null parent detaches the entity, it keeps its transform as a root
+					if (parentComponent.parent.IsNull()) {
+						continue;
+					}
+
+					// Parents renumbered by Registry::Compact were already remapped by RemapParents, so a dead parent was killed
+					if (!registry->IsAlive(parentComponent.parent)) {
+						isOrphan[i] = 1;
+						continue;
+					}
+
+					const Entity parent = registry->GetEntity(parentComponent.parent);
+					if (!parent.HasComponent<TransformComponent>()) {
+						continue;
+					}
+
+					// Only subtrees below a moved parent or a changed offset are recomputed
+					if (!isRebuilt && !parent.HasChanged<TransformComponent>(sinceTick) && !entity.HasChanged<ParentComponent>(sinceTick)) {
+						continue;
+					}
+
+					const auto& parentTransform = parent.ReadComponent<TransformComponent>();
+					auto& transform = entity.GetComponent<TransformComponent>();
+
+					const double radians = glm::radians(parentTransform.rotation);
+					const float cosine = static_cast<float>(std::cos(radians));
+					const float sine = static_cast<float>(std::sin(radians));
+					const glm::vec2 offset = parentComponent.localPosition * parentTransform.scale;
+
+					transform.position = parentTransform.position + glm::vec2(offset.x * cosine - offset.y * sine, offset.x * sine + offset.y * cosine);
+					transform.scale = parentTransform.scale * parentComponent.localScale;
+					transform.rotation = parentTransform.rotation + parentComponent.localRotation;
+					entity.MarkChanged<TransformComponent>();
+				}
+			});
+
+			// Children of killed parents go with them, the system may run on a worker so the kills are deferred
+			CommandBuffer& commandBuffer = registry->GetCommandBuffer();
+			for (size_t i = 0; i < batch.size(); i++) {
+				if (isOrphan[i]) {
+					commandBuffer.KillEntity(registry->GetEntity(batch[i]));
+				}
+			}
+		}
+
+		// Taken after the writes, so the next update doesnt react to the transforms this one marked changed
+		lastTick = registry->AdvanceTick();
+	}
+};
+
+#endif // HIERARCHYSYSTEM_H
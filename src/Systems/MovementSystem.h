@@ -14,28 +14,46 @@ public:
 	{
 		RequireComponent<TransformComponent>();
 		RequireComponent<RigidBodyComponent>();
+
+		WritesComponent<TransformComponent>();
+		ReadsComponent<RigidBodyComponent>();
 	}
 
 	void Update(double deltaTime)
 	{
-		for (auto& entity : GetSystemEntities())
+		if (registry->GetStorageBackend() == StorageBackend::Archetype)
 		{
-			auto& transform = entity.GetComponent<TransformComponent>();
-			const auto rigidBody = entity.GetComponent<RigidBodyComponent>();
-
-			transform.position.x += rigidBody.velocity.x * deltaTime;
-			transform.position.y += rigidBody.velocity.y * deltaTime;
-
-			Logger::Log(
-				"Entity id: " + 
-				std::to_string(entity.GetId()) + 
-				" position is now (" + 
-				std::to_string(transform.position.x) + 
-				", " + 
-				std::to_string(transform.position.y) + 
-				")"
+			// Stream the transform and rigid body columns side by side, chunk by chunk
+			registry->ForEachChunk<TransformComponent, RigidBodyComponent>(
+				[this, deltaTime](int count, const int* entityIds, TransformComponent* transforms, RigidBodyComponent* rigidBodies)
+				{
+					for (int i = 0; i < count; i++)
+					{
+						if (rigidBodies[i].velocity.x == 0.0f && rigidBodies[i].velocity.y == 0.0f)
+						{
+							continue;
+						}
+						transforms[i].position.x += rigidBodies[i].velocity.x * deltaTime;
+						transforms[i].position.y += rigidBodies[i].velocity.y * deltaTime;
+						registry->MarkChanged<TransformComponent>(entityIds[i]);
+					}
+				}
 			);
+			return;
 		}
+
+		registry->View<TransformComponent, RigidBodyComponent>().ParallelEach(
+			[deltaTime](Entity entity, TransformComponent& transform, RigidBodyComponent& rigidBody)
+			{
+				if (rigidBody.velocity.x == 0.0f && rigidBody.velocity.y == 0.0f)
+				{
+					return;
+				}
+				transform.position.x += rigidBody.velocity.x * deltaTime;
+				transform.position.y += rigidBody.velocity.y * deltaTime;
+				entity.MarkChanged<TransformComponent>();
+			}
+		);
 	}
 };
 
@@ -11,12 +11,15 @@ public:
 	RenderCollisionSystem() {
 		RequireComponent<TransformComponent>();
 		RequireComponent<BoxColliderComponent>();
+
+		ReadsComponent<TransformComponent>();
+		ReadsComponent<BoxColliderComponent>();
 	}
 
 	void Update(SDL_Renderer* renderer) {
-		for (auto& entity : GetSystemEntities()) {
-			auto& transform = entity.GetComponent<TransformComponent>();
-			auto& collider = entity.GetComponent<BoxColliderComponent>();
+		for (auto entity : GetSystemEntities()) {
+			const auto& transform = entity.ReadComponent<TransformComponent>();
+			const auto& collider = entity.ReadComponent<BoxColliderComponent>();
 
 			SDL_Rect rect = {
 				transform.position.x + collider.offset.x,
@@ -14,41 +14,110 @@
 // Helper struct for sorting by zIndex
 struct RenderableEntity 
 {
-	TransformComponent transformComponent;
-	SpriteComponent spriteComponent;
+	EntityHandle entity;
+	int zIndex;
 };
 
 
 class RenderSystem : public System
 {
+private:
+	// Entities sorted by zIndex, kept between frames and only re-sorted when needed
+	std::vector<RenderableEntity> renderableEntities;
+
+	// Entity id to index in renderableEntities, -1 if the entity is not in the list
+	std::vector<int> entityIdToRenderable;
+
+	uint32_t renderedMembershipVersion = UINT32_MAX;
+	uint32_t lastTick = 0;
+
+	void RebuildRenderableEntities()
+	{
+		const auto entities = GetSystemEntities();
+		renderableEntities.resize(entities.size());
+
+		// Gathering only reads the components, so it can be split across the workers
+		registry->ParallelFor(entities.size(), [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				Entity entity = entities[i];
+				renderableEntities[i].entity = entity.GetHandle();
+				renderableEntities[i].zIndex = entity.ReadColdComponent<SpriteComponent>().zIndex;
+			}
+		});
+	}
+
+	void SortRenderableEntities()
+	{
+		std::stable_sort(renderableEntities.begin(), renderableEntities.end(), [](const RenderableEntity& a, const RenderableEntity& b) {
+			return a.zIndex < b.zIndex;
+		});
+
+		entityIdToRenderable.assign(entityIdToRenderable.size(), -1);
+		for (int i = 0; i < static_cast<int>(renderableEntities.size()); i++)
+		{
+			const int entityId = renderableEntities[i].entity.GetIndex();
+			if (entityId >= static_cast<int>(entityIdToRenderable.size()))
+			{
+				entityIdToRenderable.resize(entityId + 1, -1);
+			}
+			entityIdToRenderable[entityId] = i;
+		}
+	}
+
 public:
 	RenderSystem()
 	{
 		RequireComponent<TransformComponent>();
 		RequireComponent<SpriteComponent>();
+
+		ReadsComponent<TransformComponent>();
+		ReadsComponent<SpriteComponent>();
+		ReadsComponent<SpriteColdComponent>();
 	}
 
 	void Update(SDL_Renderer* renderer, std::unique_ptr<AssetStore>& assetStore)
 	{
-		// Sorting by zIndex
-		std::vector<RenderableEntity> renderableEntities;
+		const uint32_t sinceTick = lastTick;
+		lastTick = registry->AdvanceTick();
 
-		for (auto& entity : GetSystemEntities())
+		// Sorting by zIndex, only when entities came or went or a sprite changed its zIndex
+		bool needsSort = false;
+		if (GetMembershipVersion() != renderedMembershipVersion)
 		{
-			RenderableEntity renderableEntity;
-			renderableEntity.transformComponent = entity.GetComponent<TransformComponent>();
-			renderableEntity.spriteComponent = entity.GetComponent<SpriteComponent>();
-
-			renderableEntities.emplace_back(renderableEntity);
+			RebuildRenderableEntities();
+			renderedMembershipVersion = GetMembershipVersion();
+			needsSort = true;
+		}
+		else
+		{
+			// zIndex lives in the cold part, so animated sprites dont show up here every frame
+			for (auto [entity, coldSprite] : registry->View<SpriteColdComponent>(Changed<SpriteColdComponent>(sinceTick)))
+			{
+				const int entityId = entity.GetId();
+				if (entityId >= static_cast<int>(entityIdToRenderable.size()) || entityIdToRenderable[entityId] == -1)
+				{
+					continue;
+				}
+				RenderableEntity& renderableEntity = renderableEntities[entityIdToRenderable[entityId]];
+				if (renderableEntity.zIndex != coldSprite.zIndex)
+				{
+					renderableEntity.zIndex = coldSprite.zIndex;
+					needsSort = true;
+				}
+			}
+		}
+		if (needsSort)
+		{
+			SortRenderableEntities();
 		}
-		std::sort(renderableEntities.begin(), renderableEntities.end(), [](const RenderableEntity& a, const RenderableEntity& b) {
-			return a.spriteComponent.zIndex < b.spriteComponent.zIndex;
-		});
 		
-		for (auto& entity : renderableEntities)
+		for (auto& renderableEntity : renderableEntities)
 		{
-			const auto transform = entity.transformComponent;
-			const auto sprite = entity.spriteComponent;
+			const Entity entity = registry->GetEntity(renderableEntity.entity);
+			const auto& transform = entity.ReadComponent<TransformComponent>();
+			const auto& sprite = entity.ReadComponent<SpriteComponent>();
 
 			// Set the source rectangle of our original sprite texture
 			SDL_Rect srcRect = sprite.srcRect;
@@ -63,7 +132,7 @@ public:
 
 			SDL_RenderCopyEx(
 				renderer,
-				assetStore->GetTexture(sprite.assetId),
+				assetStore->GetTexture(sprite.assetHandle),
 				&srcRect,
 				&dstRect,
 				transform.rotation,
@@ -0,0 +1,62 @@
+#ifndef TILEMAPRENDERSYSTEM_H
+#define TILEMAPRENDERSYSTEM_H
+
+#include "../ECS/ECS.h"
+#include "../AssetStore/AssetStore.h"
+#include "../Components/TransformComponent.h"
+#include "../Components/TileComponent.h"
+#include "SDL.h"
+
+// Draws the tiles under every other sprite
+// Tiles are walked per shared TilemapComponent, so the texture is looked up once per run of tiles that use it
+// Other holders of a TilemapComponent are skipped, only members of the system have a transform and a tile
+class TilemapRenderSystem : public System
+{
+public:
+	TilemapRenderSystem()
+	{
+		RequireComponent<TransformComponent>();
+		RequireComponent<TileComponent>();
+		RequireComponent<TilemapComponent>();
+
+		ReadsComponent<TransformComponent>();
+		ReadsComponent<TileComponent>();
+		ReadsComponent<TilemapComponent>();
+	}
+
+	void Update(SDL_Renderer* renderer, std::unique_ptr<AssetStore>& assetStore)
+	{
+		registry->ForEachSharedValue<TilemapComponent>([&](const TilemapComponent& tilemap, EntitySpan tiles)
+		{
+			SDL_Texture* texture = assetStore->GetTexture(tilemap.assetHandle);
+			for (Entity tile : tiles)
+			{
+				if (!HasEntity(tile) || !tile.IsEnabled())
+				{
+					continue;
+				}
+				const auto& transform = tile.ReadComponent<TransformComponent>();
+				const auto& srcRect = tile.ReadComponent<TileComponent>().srcRect;
+
+				SDL_Rect dstRect{
+					static_cast<int>(transform.position.x),
+					static_cast<int>(transform.position.y),
+					static_cast<int>(tilemap.width * transform.scale.x),
+					static_cast<int>(tilemap.height * transform.scale.y)
+				};
+
+				SDL_RenderCopyEx(
+					renderer,
+					texture,
+					&srcRect,
+					&dstRect,
+					transform.rotation,
+					NULL,
+					SDL_FLIP_NONE
+				);
+			}
+		});
+	}
+};
+
+#endif